@@ -1,7 +1,13 @@
 #include <iostream>
 #include <cmath>
+#include <cstring>
 #include <fstream>
 #include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unistd.h>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -10,6 +16,24 @@
 #include <glm/glm.hpp>
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "sim.h"
+#include "hint.h"
+#include "level_file.h"
+#include "level_text.h"
+#include "level_pack.h"
+#include "timeline.h"
+#include "input_queue.h"
+#include "replay.h"
+#include "obs_ring.h"
+#include "alloc_track.h"
+#include "arena.h"
+#include "tile_store.h"
+#ifdef BLOX_BENCH
+#include <chrono>
+#include "bench.h"
+#endif
 
 using namespace std;
 
@@ -41,26 +65,48 @@ struct Block{
   int fall_status;
   int color;
   int x_destination,z_destination;
-  glm::vec3 rotate_vector;
-  double r_x,r_y,r_z;
-  glm::mat4 rotation_matrix;
+  int orient;         // index into orientation[]
 };
 
+/*
+ * The block can only ever lie in one of the 24 orientations of a cube. Each
+ * is kept as an exact integer rotation with its quaternion and the
+ * orientation every roll leads to, so finished rolls are a table lookup and
+ * never accumulate rounding.
+ */
+struct Orientation {
+  signed char m[9];   // row major
+  glm::quat q;
+  int next[4];        // after a roll U, D, L, R
+};
+Orientation orientation[24];
+/* Axis each roll turns the block about, by key as in move_key */
+static const int roll_axis[4][3]={{-1,0,0},{1,0,0},{0,0,1},{0,0,-1}};
+
+/* Tiles and bridges are instances of one cuboid, animated by Tile_GL.vert */
+#define MAX_INSTANCES (14*14+4)
+#define ANIM_SPAWN        0
+#define ANIM_DROP         1
+#define ANIM_BRIDGE_LEFT  2
+#define ANIM_BRIDGE_RIGHT 3
 struct Board{
-  VAO *tile[14][14];
-  int tile_type[14][14];
-  double tile_xpos[14][14],tile_ypos[14][14],tile_zpos[14][14];
-  double angle[14][14];
-  int tile_order[400];
-  int tiles_created;
+  VAO *tiles;                   // cuboid plus per instance place, color and anim
+  GLuint anim_buffer;           // start time, kind, from and to angle per instance
+  int anim_capacity;            // instances anim_buffer has room for
+  GLuint programID,MatrixID,TimeID;
+  GLuint instance_buffer;       // the one attachInstances pointed the tiles at
+  TileStore *store;             // the playing level's tiles, in instance order
+  std::vector<uint8_t> type;    // store->type as played: broken tiles are 0, bridges open and close
+  double spawn_time;            // tile k appears 0.1*(k+1) s after this
   int no_of_tiles;
 };
 struct Bridge{
-  VAO *bridge[2];
+  bool shown;                   // drawn once the tiles are all in
   double x_pos[2];
   double z_pos[2];
   double angle;
   bool bridge_status;
+  bool turning;
   double height,length,breadth;
 };
 struct View{
@@ -73,11 +119,99 @@ struct View{
 };
 bool hang;
 int LEVEL;
+Timeline timeline;            // every animation of the block and the bridges
+InputQueue input;             // rolls asked for and not played yet
+/* The game steps in fixed ticks, so a replay meets every animation at the
+   same point it was recorded at */
+#define TICK (1.0/REPLAY_TICK_HZ)
+uint64_t tick;
+double sim_time;              // tick*TICK, the clock of every animation
+double clock_origin;          // glfwGetTime() at tick 0
+ReplayWriter recorder;        // recorder.f is NULL unless recording
+Replay replay;
+size_t replay_next;
+bool replaying;
+ObsRing share;                // share.h is NULL unless publishing observations
 struct Block block;
 struct Board board;
 struct Bridge bridge[2];
+/* Everything a level needs to be played: the level and the storage behind it,
+   its hint table and its tiles on the GPU. The playing slot is only swapped
+   on the main thread; the other one is where the next level gets loaded */
+struct LevelSlot{
+  int level;                    // 0 while empty
+  Level lvl;
+  MappedLevel map;
+  Arena arena;                  // whatever lives as long as the level, reset by load_level
+  TileStore tiles;              // in the arena
+  LevelParse parse;
+  HintTable hints;
+  GLuint instance_buffer;       // place and color of the tiles in spawn order, then the bridge halves
+  GLsync uploaded;              // set when another context did the upload
+};
+LevelSlot level_slot[2];
+LevelSlot *playing=&level_slot[0];
+LevelPack pack;
+int no_of_levels;
+/* Prefetch thread, with its own hidden window sharing the game's objects */
+GLFWwindow *loader_window;
+std::thread loader;
+std::mutex loader_mutex;
+std::condition_variable loader_cv;
+int prefetch_request,prefetch_busy;
+bool loader_quit;
+void stop_loader();
+void prefetch_level(int level);
+/* Input to photon: every frame drawn after a roll started is fenced, and
+   the key's age is taken when the frame is submitted, swapped and done on
+   the GPU. Low latency mode also waits on these fences so that no more than
+   max_frames_in_flight frames are queued ahead of the GPU */
+struct FrameMark{
+  GLsync fence;
+  double input_time;            // < 0 when no roll started in this frame
+};
+/* A ring, so fencing frames never allocates; a full one waits on its oldest */
+#define MAX_FRAME_MARKS 16
+FrameMark frame_mark[MAX_FRAME_MARKS];
+int first_mark,no_of_marks;
+double pending_input=-1;        // key time of the roll the next frame shows first
+/* Only the first LATENCY_ROLLS rolls are kept, so recording never allocates */
+#define LATENCY_ROLLS 16384
+std::vector<double> latency_submit,latency_swap,latency_done;
+uint64_t latency_unkept;        // rolls after those
+int swap_interval=1;
+int max_frames_in_flight;       // 0 unless in low latency mode
+void report_latency();
+/* Heap traffic of the main thread per frame and subsystem, counted when the
+   game is built with BLOX_ALLOC_TRACK */
+AllocScope alloc_simulate,alloc_draw,alloc_present,alloc_level;
+uint64_t alloc_outside;          // allocations outside level loads as of the last frame
+uint64_t alloc_frames,alloc_frames_allocating;
+bool zero_alloc;                // -zeroalloc: only level loads may allocate
+#ifdef BLOX_ARENA_DEBUG
+bool show_stats=true;
+#else
+bool show_stats;                // -stats: print the arenas on quit
+#endif
+void report_allocs();
+/* Scratch of the frame, reset at the top of every frame */
+Arena frame_arena;
+int hint_angle=-1;
 GLuint programID;
 GLFWwindow* window;
+/* A shader source file, line by line as LoadShaders always read it */
+void read_shader(const char *path, std::string *code)
+{
+	code->clear();
+	std::ifstream stream(path, std::ios::in);
+	if(stream.is_open())
+	{
+		std::string Line = "";
+		while(getline(stream, Line))
+			*code += "\n" + Line;
+		stream.close();
+	}
+}
 /* Function to load Shaders - Use it as it is */
 GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path) {
 
@@ -85,26 +219,10 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
 	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
 
-	// Read the Vertex Shader code from the file
-	std::string VertexShaderCode;
-	std::ifstream VertexShaderStream(vertex_file_path, std::ios::in);
-	if(VertexShaderStream.is_open())
-	{
-		std::string Line = "";
-		while(getline(VertexShaderStream, Line))
-			VertexShaderCode += "\n" + Line;
-		VertexShaderStream.close();
-	}
-
-	// Read the Fragment Shader code from the file
-	std::string FragmentShaderCode;
-	std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
-	if(FragmentShaderStream.is_open()){
-		std::string Line = "";
-		while(getline(FragmentShaderStream, Line))
-			FragmentShaderCode += "\n" + Line;
-		FragmentShaderStream.close();
-	}
+	// Read the shader code from the files
+	std::string VertexShaderCode,FragmentShaderCode;
+	read_shader(vertex_file_path, &VertexShaderCode);
+	read_shader(fragment_file_path, &FragmentShaderCode);
 
 	GLint Result = GL_FALSE;
 	int InfoLogLength;
@@ -162,6 +280,35 @@ static void error_callback(int error, const char* description)
 
 void quit(GLFWwindow *window)
 {
+    alloc_forbid(false);
+    if(timeline.updates>0)
+      fprintf(stderr,"animation: %.2f us per frame, %.1f ns per track\n",
+              timeline.seconds/timeline.updates*1e6,
+              timeline.evaluated>0 ? timeline.seconds/timeline.evaluated*1e9 : 0.0);
+    if(input.popped>0||input.dropped>0)
+      fprintf(stderr,"input: %llu rolls queued %.1f ms on average, %.1f ms at most, %llu dropped\n",
+              (unsigned long long)input.popped,input.popped>0 ? input.wait/input.popped*1e3 : 0.0,
+              input.max_wait*1e3,(unsigned long long)input.dropped);
+    report_latency();
+    // The loader may be filling a level slot's arena
+    stop_loader();
+    report_allocs();
+    if(show_stats||alloc_tracking())
+    {
+      arena_report(&frame_arena);
+      arena_report(&level_slot[0].arena);
+      arena_report(&level_slot[1].arena);
+    }
+    if(recorder.f!=NULL)
+    {
+      if(replay_finish(&recorder,tick))
+        fprintf(stderr,"replay: %llu events in %llu bytes\n",(unsigned long long)recorder.events,
+                (unsigned long long)recorder.bytes);
+      else
+        fprintf(stderr,"Could not write the replay\n");
+    }
+    if(share.h!=NULL)
+      obs_ring_close(&share);
     glfwDestroyWindow(window);
     glfwTerminate();
     exit(EXIT_SUCCESS);
@@ -211,7 +358,7 @@ struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloa
 /* Generate VAO, VBOs and return VAO handle - Common Color for all vertices */
 struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloat* vertex_buffer_data, const GLfloat red, const GLfloat green, const GLfloat blue, GLenum fill_mode=GL_FILL)
 {
-    GLfloat* color_buffer_data = new GLfloat [3*numVertices];
+    GLfloat* color_buffer_data = arena_array<GLfloat>(&frame_arena,3*numVertices);
     for (int i=0; i<numVertices; i++) {
         color_buffer_data [3*i] = red;
         color_buffer_data [3*i + 1] = green;
@@ -258,32 +405,85 @@ double x_pos,y_pos;
 double x_pos1,y_pos1;
 bool helicopterview,shift,cam_follow,ortho,block_view;
 double x_direction,z_direction;
+/* Sim state of the block while it rests on the board */
+void block_state(SimState *s)
+{
+  s->orient=STANDING;
+  if(block.length>block.height) s->orient=LYING_X;
+  if(block.breadth>block.height) s->orient=LYING_Z;
+  s->x=lround((block.x_pos-(s->orient==LYING_X)*0.25)*2);
+  s->z=lround((block.z_pos-(s->orient==LYING_Z)*0.25)*2);
+  s->bridges=0;
+  for(int i=0;i<playing->lvl.no_of_bridges&&i<2;i++)
+    if(bridge[i].bridge_status)
+      s->bridges|=1u<<i;
+}
+/* Point the on screen arrow along the best roll from here */
+void show_hint()
+{
+  static const int arrow_angle[4]={90,270,180,0};
+  SimState s;
+  if(hang||block.fall_status!=0||playing->hints.entry==NULL)
+    return;
+  block_state(&s);
+  uint64_t index=sim_state_index(&playing->lvl,&s);
+  if(hint_distance(&playing->hints,index)!=HINT_NONE)
+    hint_angle=arrow_angle[hint_move(&playing->hints,index)];
+}
 /* Executed when a regular key is pressed/released/held-down */
 /* Prefered for Keyboard events */
 void initialize_view(bool a,bool b,bool c,bool d)
 {
   shift=a;ortho=b;cam_follow=c,block_view=d;
 }
-void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
+/* Log an input for -record, stamped with the tick it takes effect in */
+void record(uint8_t type,uint32_t code,uint8_t action,uint8_t button=0,float x=0,float y=0)
+{
+  if(recorder.f==NULL)
+    return;
+  ReplayEvent e;
+  memset(&e,0,sizeof(e));
+  e.tick=tick;
+  e.type=type;
+  if(type==REPLAY_ROLL)
+    e.move=code;
+  else
+    e.code=code;
+  e.action=action;
+  e.button=button;
+  e.x=x;e.y=y;
+  replay_write(&recorder,&e);
+}
+void queue_roll(char key)
+{
+  record(REPLAY_ROLL,(const char *)memchr(move_key,key,4)-move_key,0);
+  iq_push(&input,key,glfwGetTime());
+}
+/* Keys, mouse buttons and characters, live or from a replay */
+void key_event(int key,int action)
 {
+    bool arrow=key==GLFW_KEY_UP||key==GLFW_KEY_DOWN||key==GLFW_KEY_LEFT||key==GLFW_KEY_RIGHT;
+    if (action == GLFW_RELEASE && arrow && !block_view) {
+        queue_roll(key==GLFW_KEY_UP ? 'U' : key==GLFW_KEY_DOWN ? 'D' : key==GLFW_KEY_LEFT ? 'L' : 'R');
+        return;
+    }
+    // Arrow presses only matter when they end the helicopter view
+    if (action == GLFW_RELEASE ? arrow : action == GLFW_PRESS && (!arrow || helicopterview))
+        record(REPLAY_KEY,key,action);
      // Function is called first on GLFW_PRESS.
-    if (action == GLFW_RELEASE && !hang) {
+    if (action == GLFW_RELEASE) {
         switch (key) {
             case GLFW_KEY_DOWN:
-              if(block_view){x_direction=0;z_direction=1;}
-              else{block.key='D';block.angle+=10;}
+              x_direction=0;z_direction=1;
               break;
             case GLFW_KEY_LEFT:
-              if(block_view){x_direction=-1;z_direction=0;}
-              else{block.key='L';block.angle+=10;}
+              x_direction=-1;z_direction=0;
               break;
             case GLFW_KEY_RIGHT:
-              if(block_view){x_direction=1;z_direction=0;}
-              else{block.key='R';block.angle+=10;}
+              x_direction=1;z_direction=0;
               break;
             case GLFW_KEY_UP:
-              if(block_view){x_direction=0;z_direction=-1;}
-              else{block.key='U';block.angle+=10;}
+              x_direction=0;z_direction=-1;
               break;
             default:
               break;
@@ -316,6 +516,9 @@ void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
           case GLFW_KEY_B:
           initialize_view(false,false,false,true);
             break;
+          case GLFW_KEY_I:
+            show_hint();
+            break;
           case GLFW_KEY_ESCAPE:
             quit(window);
             break;
@@ -324,48 +527,69 @@ void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
         }
     }
 }
+void keyboard (GLFWwindow* /*window*/, int key, int scancode, int action, int mods)
+{
+  if(!replaying)
+    key_event(key,action);
+}
 
-/* Executed for character input (like in text boxes) */
-void keyboardChar (GLFWwindow* window, unsigned int key)
+void char_event(unsigned int key)
 {
 	switch (key) {
 		case 'Q':
 		case 'q':
+            record(REPLAY_CHAR,key,0);
             quit(window);
             break;
 		default:
 			break;
 	}
 }
+/* Executed for character input (like in text boxes) */
+void keyboardChar (GLFWwindow* /*window*/, unsigned int key)
+{
+  if(!replaying)
+    char_event(key);
+}
 
-/* Executed when a mouse button is pressed/released */
-void mouseButton (GLFWwindow* window, int button, int action, int mods)
+/* x and y are the cursor in window pixels */
+void mouse_event(int button,int action,double x,double y)
 {
     switch (button) {
         case GLFW_MOUSE_BUTTON_LEFT:
-          glfwGetCursorPos(window,&x_pos,&y_pos);
-          x_pos=8*((x_pos-fbwidth/2)/fbwidth*1.0);
-          y_pos=-8*((y_pos-fbheight/2)/fbheight*1.0);
-          if(x_pos>3.3&&x_pos<4&&y_pos>-3.3&&y_pos<-2.7){block.key='R';block.angle+=10;}
-          else if(x_pos>2&&x_pos<3.3&&y_pos>-3.3&&y_pos<-2.7){block.key='L';block.angle+=10;}
-          else if(x_pos>2.7&&x_pos<3.3&&y_pos>-2.7&&y_pos<-2){block.key='U';block.angle+=10;}
-          else if(x_pos>2.7&&x_pos<3.3&&y_pos>-4&&y_pos<-3.3){block.key='D';block.angle+=10;}
+          if(action!=GLFW_PRESS)
+            break;
+          x_pos=8*((x-fbwidth/2)/fbwidth*1.0);
+          y_pos=-8*((y-fbheight/2)/fbheight*1.0);
+          if(x_pos>3.3&&x_pos<4&&y_pos>-3.3&&y_pos<-2.7)queue_roll('R');
+          else if(x_pos>2&&x_pos<3.3&&y_pos>-3.3&&y_pos<-2.7)queue_roll('L');
+          else if(x_pos>2.7&&x_pos<3.3&&y_pos>-2.7&&y_pos<-2)queue_roll('U');
+          else if(x_pos>2.7&&x_pos<3.3&&y_pos>-4&&y_pos<-3.3)queue_roll('D');
             break;
         case GLFW_MOUSE_BUTTON_RIGHT:
+            record(REPLAY_MOUSE,0,action,button,x,y);
             if (action == GLFW_RELEASE)
               mouse_left=false;
             else if(action == GLFW_PRESS)
             {
               mouse_left=true;
-              glfwGetCursorPos(window,&x_pos,&y_pos);
-              x_pos=8*((x_pos-fbwidth/2)/fbwidth*1.0);
-              y_pos=-8*((y_pos-fbheight/2)/fbheight*1.0);
+              x_pos=8*((x-fbwidth/2)/fbwidth*1.0);
+              y_pos=-8*((y-fbheight/2)/fbheight*1.0);
             }
             break;
         default:
             break;
     }
 }
+/* Executed when a mouse button is pressed/released */
+void mouseButton (GLFWwindow* window, int button, int action, int mods)
+{
+  double x,y;
+  if(replaying)
+    return;
+  glfwGetCursorPos(window,&x,&y);
+  mouse_event(button,action,x,y);
+}
 
 /* Executed when window is resized to 'width' and 'height' */
 /* Modify the bounds of the screen here in glm::ortho or Field of View in glm::Perspective */
@@ -390,6 +614,7 @@ void reshapeWindow (GLFWwindow* window, int width, int height)
 }
 
 VAO *triangle, *rectangle,*cube;
+VAO *hint_triangle,*hint_rectangle;
 
 // Creates the triangle object used in this sample code
 void createTriangle ()
@@ -440,7 +665,28 @@ void createRectangle ()
   rectangle = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data, GL_FILL);
 }
 
-void CreateCuboid(float l,float h,float b,int c,VAO **object)
+// Same arrow in plain green, drawn over the direction suggested by the hint table
+void createHintArrow ()
+{
+  static const GLfloat triangle_data [] = {
+    0, 1,0,
+    1,0,0,
+    0,-1,0,
+  };
+  static const GLfloat rectangle_data [] = {
+    0,0.5,0,
+    -1,0.5,0,
+    -1,-0.5,0,
+
+    -1,-0.5,0,
+    0,-0.5,0,
+    0,0.5,0
+  };
+  hint_triangle = create3DObject(GL_TRIANGLES, 3, triangle_data, 0, 1, 0, GL_FILL);
+  hint_rectangle = create3DObject(GL_TRIANGLES, 6, rectangle_data, 0, 1, 0, GL_FILL);
+}
+
+void cuboid_color(int c,GLfloat rgb[3])
 {
   int red=1,green=1,blue=1;
   if(c==0) red=0;
@@ -448,7 +694,14 @@ void CreateCuboid(float l,float h,float b,int c,VAO **object)
   if(c==2) blue=0;
   if(c==4) {green=0;red=0;}
   if(c==3) {green=0;blue=0;}
-  GLfloat color_buffer_data [108];
+  rgb[0]=red;rgb[1]=green;rgb[2]=blue;
+}
+/* 36 vertices and colors of an l x h x b cuboid centred on the origin */
+void cuboid_data(float l,float h,float b,int c,GLfloat vertex[108],GLfloat color_buffer_data[108])
+{
+  GLfloat rgb[3];
+  cuboid_color(c,rgb);
+  GLfloat red=rgb[0],green=rgb[1],blue=rgb[2];
   // GL3 accepts only Triangles. Quads are not supported
 
   GLfloat vertex_buffer_data [] = {
@@ -501,9 +754,59 @@ void CreateCuboid(float l,float h,float b,int c,VAO **object)
     }
   }
 }
+  memcpy(vertex,vertex_buffer_data,sizeof(vertex_buffer_data));
+}
+void CreateCuboid(float l,float h,float b,int c,VAO **object)
+{
+  GLfloat vertex_buffer_data[108],color_buffer_data[108];
+  cuboid_data(l,h,b,c,vertex_buffer_data,color_buffer_data);
   // create3DObject creates and returns a handle to a VAO that can be used later
   *object = create3DObject(GL_TRIANGLES, 36, vertex_buffer_data, color_buffer_data, GL_FILL);
 }
+VAO *block_mesh;
+/* Block and tile geometry never changes, so it is made once in initGL */
+void createMeshes()
+{
+  CreateCuboid(0.5,1,0.5,5,&block_mesh);
+
+  // A white tile; each instance scales, colors and moves it
+  CreateCuboid(0.5,0.2,0.5,5,&board.tiles);
+  glGenBuffers(1,&board.anim_buffer);
+  glBindBuffer(GL_ARRAY_BUFFER,board.anim_buffer);
+  glBufferData(GL_ARRAY_BUFFER,MAX_INSTANCES*4*sizeof(GLfloat),NULL,GL_DYNAMIC_DRAW);
+  board.anim_capacity=MAX_INSTANCES;
+  glBindVertexArray(board.tiles->VertexArrayID);
+  glEnableVertexAttribArray(0);
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(4,4,GL_FLOAT,GL_FALSE,0,(void*)0);
+  glVertexAttribDivisor(4,1);
+  glEnableVertexAttribArray(4);
+}
+/* Point the instanced tiles at a level's uploaded places and colors */
+void attachInstances(GLuint instance_buffer)
+{
+  board.instance_buffer=instance_buffer;
+  glBindVertexArray(board.tiles->VertexArrayID);
+  glBindBuffer(GL_ARRAY_BUFFER,instance_buffer);
+  glVertexAttribPointer(2,4,GL_FLOAT,GL_FALSE,7*sizeof(GLfloat),(void*)0);
+  glVertexAttribPointer(3,3,GL_FLOAT,GL_FALSE,7*sizeof(GLfloat),(void*)(4*sizeof(GLfloat)));
+  glVertexAttribDivisor(2,1);
+  glVertexAttribDivisor(3,1);
+  glEnableVertexAttribArray(2);
+  glEnableVertexAttribArray(3);
+}
+/* Start an animation on one instance; the shader does the rest */
+void animate(int instance,int kind,double from,double to)
+{
+  GLfloat anim[4]={(GLfloat)(sim_time-board.spawn_time),(GLfloat)kind,(GLfloat)from,(GLfloat)to};
+  glBindBuffer(GL_ARRAY_BUFFER,board.anim_buffer);
+  glBufferSubData(GL_ARRAY_BUFFER,instance*sizeof(anim),sizeof(anim),anim);
+}
+void animateBridge(int i,double from,double to)
+{
+  animate(board.no_of_tiles+2*i,ANIM_BRIDGE_LEFT,from,to);
+  animate(board.no_of_tiles+2*i+1,ANIM_BRIDGE_RIGHT,from,to);
+}
 void createBlock()
 {
   block.length=0.5;
@@ -511,55 +814,91 @@ void createBlock()
   block.height=1;
   block.y_pos=block.height/2+0.5;
   block.angle=0;block.fall_status=0;
-  block.rotate_vector=glm::vec3(0,0,1);
-  block.rotation_matrix=glm::mat4(1.0f);
+  block.orient=0;
   block.fall_status=2;block.color=5;
-  CreateCuboid(block.length,block.height,block.breadth,block.color,&block.cuboid);
+  block.cuboid=block_mesh;
+}
+/* Input waits while the block or a bridge is still moving */
+void settle()
+{
+  hang=bridge[0].turning||bridge[1].turning;
+}
+void landed(void *)
+{
+  block.fall_status=0;
+  settle();
 }
 void createBridge(struct Bridge *bridge)
 {
-  if(LEVEL==3)
+  if(playing->lvl.no_of_bridges>0)
   {
     bridge->angle=0;
     bridge->length=0.5;bridge->height=0.1;bridge->breadth=0.5;
-    CreateCuboid(bridge->length,bridge->height,bridge->breadth,1,&bridge->bridge[0]);
-    CreateCuboid(bridge->length,bridge->height,bridge->breadth,1,&bridge->bridge[1]);
+    bridge->shown=true;
   }
 }
-void createTile(int i,int j)
+/* The type of the tile on a cell as played, 0 off the board */
+int tile_type(int x,int z)
 {
-  int color;
-  board.tile_xpos[i][j]=i/2.0;
-  board.tile_ypos[i][j]=-0.2/2.0;
-  board.tile_zpos[i][j]=j/2.0;
-  if(board.tile_type[i][j]==1) color=0;
-  else color=board.tile_type[i][j];
-  CreateCuboid(0.5,0.2,0.5,color,&board.tile[i][j]);
+  int k=tile_entry(board.store,x,z);
+  return k<0 ? 0 : board.type[k];
 }
-void moveBridge(struct Bridge bridge,glm::mat4 VP)
+/* Change a tile as played; a restart puts back the chunks changed.
+   Returns its entry, -1 and nothing changed for a cell with no tile */
+int set_tile_type(int x,int z,int type)
 {
-  glm::mat4 MVP;
-  Matrices.model=glm::mat4(1.0f);
-  glm::mat4 translateRectangle = glm::translate (glm::vec3(-bridge.length/2,-bridge.height/2,0));        // glTranslatef
-  translateRectangle*=glm::translate (glm::vec3(bridge.x_pos[0]/2.0,-bridge.height/2.0,bridge.z_pos[0]/2.0));
-  glm::mat4 rotateRectangle = glm::rotate((float)(bridge.angle*M_PI/180.0f),glm::vec3(0,0,-1)); // rotate about vector (-1,1,1)
-  glm::mat4 translateRectangle1 = glm::translate (glm::vec3(bridge.length/2,bridge.height/2,0));
-  Matrices.model *= (translateRectangle*rotateRectangle*translateRectangle1);
-  MVP = VP * Matrices.model;
-  glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-  // draw3DObject draws the VAO given to it using current MVP matrix
-  draw3DObject(bridge.bridge[0]);
-
-  Matrices.model=glm::mat4(1.0f);
-  translateRectangle = glm::translate (glm::vec3(bridge.length/2,-bridge.height/2,0));        // glTranslatef
-  translateRectangle*=glm::translate (glm::vec3(bridge.x_pos[1]/2.0,-bridge.height/2.0,bridge.z_pos[1]/2.0));
-  rotateRectangle = glm::rotate((float)(bridge.angle*M_PI/180.0f),glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-  translateRectangle1 = glm::translate (glm::vec3(-bridge.length/2,bridge.height/2,0));
-  Matrices.model *= (translateRectangle*rotateRectangle*translateRectangle1);
-  MVP = VP * Matrices.model;
-  glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-  // draw3DObject draws the VAO given to it using current MVP matrix
-  draw3DObject(bridge.bridge[1]);
+  int k=tile_entry(board.store,x,z);
+  if(k<0)
+    return k;
+  board.type[k]=type;
+  tile_chunk(board.store,x,z)->dirty=true;
+  return k;
+}
+/* A bridge finished turning: 90 is open (no floor), 0 is walkable */
+void bridge_turned(void *arg)
+{
+  struct Bridge *bridge=(struct Bridge *)arg;
+  int type=bridge->angle>=90 ? 0 : 1;
+  for(int h=0;h<2;h++)
+    set_tile_type((int)bridge->x_pos[h],(int)bridge->z_pos[h],type);
+  bridge->bridge_status=type==1;
+  bridge->turning=false;
+  settle();
+}
+void turnBridge(int i,double to)
+{
+  double from=bridge[i].angle;
+  bridge[i].turning=true;
+  hang=true;
+  tl_add(&timeline,&bridge[i].angle,from,to,sim_time,fabs(to-from)/BRIDGE_SPEED,EASE_LINEAR,bridge_turned,&bridge[i]);
+  animateBridge(i,from,to);
+}
+/* The intro is over: the block drops in and the bridges open */
+void spawned(void *)
+{
+  createBlock();
+  tl_add(&timeline,&block.y_pos,block.y_pos,block.height/2,sim_time,LAND_SECONDS,EASE_OUT,landed,NULL);
+  for(int i=0;i<playing->lvl.no_of_bridges&&i<2;i++)
+  {
+    createBridge(&bridge[i]);
+    bridge[i].bridge_status=true;
+    turnBridge(i,90);
+  }
+}
+/* Toggle the bridges of the switches on a cell, like sim_step; a bridge
+   still turning ignores it */
+void press_switch(int x,int z)
+{
+  const Level *lvl=&playing->lvl;
+  for(int i=0;i<lvl->no_of_switches;i++)
+  {
+    const SimSwitch *sw=&lvl->sw[i];
+    if(sw->x!=x||sw->z!=z||sw->bridge>=2)
+      continue;
+    struct Bridge *b=&bridge[sw->bridge];
+    if(b->angle==0||b->angle==90)
+      turnBridge(sw->bridge,90-b->angle);
+  }
 }
 void Check_Block_Pos()
 {
@@ -568,60 +907,55 @@ void Check_Block_Pos()
   {
     x_pos=block.x_pos*2;
     z_pos=block.z_pos*2;
-    if(board.tile_type[x_pos][z_pos]==0)
+    if(tile_type(x_pos,z_pos)==0)
       block.fall_status=1;
-    if(board.tile_type[x_pos][z_pos]==2)
+    if(tile_type(x_pos,z_pos)==2)
     {
       block.fall_status=3;
-      board.tile_type[x_pos][z_pos]=0;
+      int k=set_tile_type(x_pos,z_pos,0);
+      if(k>=0)
+        animate(k,ANIM_DROP,0,0);
     }
     if(x_pos==block.x_destination && z_pos==block.z_destination)
-      block.fall_status=5;
-    if(board.tile_type[x_pos][z_pos]==4)
     {
-      if(bridge[1].angle==0)
-        bridge[1].angle=5;
-      else if(bridge[1].angle==90)
-        bridge[1].angle=85;
+      block.fall_status=5;
+      prefetch_level(LEVEL+1);
     }
+    if(tile_type(x_pos,z_pos)==4)
+      press_switch(x_pos,z_pos);
   }
   if(block.length==2*block.height)
   {
     x_pos=(block.x_pos-block.length/4.0)*2;z_pos=block.z_pos*2;
-    if(board.tile_type[x_pos][z_pos]==0&&board.tile_type[x_pos+1][z_pos]==0)
+    if(tile_type(x_pos,z_pos)==0&&tile_type(x_pos+1,z_pos)==0)
       block.fall_status=1;
-    else if(board.tile_type[x_pos][z_pos]==0)
+    else if(tile_type(x_pos,z_pos)==0)
     {
       block.key='L';
       block.angle+=25;
       block.fall_status=1;
     }
-    else if(board.tile_type[x_pos+1][z_pos]==0)
+    else if(tile_type(x_pos+1,z_pos)==0)
     {
       block.key='R';
       block.angle+=25;
       block.fall_status=1;
     }
-    else if(board.tile_type[x_pos][z_pos]==3)
-    {
-      if(bridge[0].angle==0)
-        bridge[0].angle=5;
-      else if(bridge[0].angle==90)
-        bridge[0].angle=85;
-    }
+    else if(tile_type(x_pos,z_pos)==3)
+      press_switch(x_pos,z_pos);
   }
   if(block.breadth==2*block.height)
   {
     z_pos=(block.z_pos-block.length/4.0)*2;x_pos=block.x_pos*2;
-    if(board.tile_type[x_pos][z_pos]==0&&board.tile_type[x_pos][z_pos+1]==0)
+    if(tile_type(x_pos,z_pos)==0&&tile_type(x_pos,z_pos+1)==0)
       block.fall_status=1;
-    else if(board.tile_type[x_pos][z_pos]==0)
+    else if(tile_type(x_pos,z_pos)==0)
     {
       block.key='U';
       block.angle+=25;
       block.fall_status=1;
     }
-    else if(board.tile_type[x_pos][z_pos+1]==0)
+    else if(tile_type(x_pos,z_pos+1)==0)
     {
       block.key='D';
       block.angle+=25;
@@ -629,90 +963,375 @@ void Check_Block_Pos()
     }
   }
 }
+/* Fill orientation[] by rolling the upright block every way until no new one turns up */
+void createOrientations()
+{
+  static const signed char upright[9]={1,0,0, 0,1,0, 0,0,1};
+  int count=1;
+  memcpy(orientation[0].m,upright,9);
+  for(int o=0;o<count;o++)
+  {
+    for(int k=0;k<4;k++)
+    {
+      // A quarter turn about a unit axis a is a*a' plus the cross product matrix of a
+      const int *a=roll_axis[k];
+      int turn[9]={a[0]*a[0],a[0]*a[1]-a[2],a[0]*a[2]+a[1],
+                   a[1]*a[0]+a[2],a[1]*a[1],a[1]*a[2]-a[0],
+                   a[2]*a[0]-a[1],a[2]*a[1]+a[0],a[2]*a[2]};
+      signed char m[9];
+      for(int i=0;i<3;i++)
+        for(int j=0;j<3;j++)
+          m[i*3+j]=turn[i*3]*orientation[o].m[j]+turn[i*3+1]*orientation[o].m[3+j]+
+                   turn[i*3+2]*orientation[o].m[6+j];
+      int n=0;
+      while(n<count&&memcmp(orientation[n].m,m,9)!=0)
+        n++;
+      if(n==count)
+        memcpy(orientation[count++].m,m,9);
+      orientation[o].next[k]=n;
+    }
+    glm::mat3 r;
+    for(int i=0;i<3;i++)
+      for(int j=0;j<3;j++)
+        r[j][i]=orientation[o].m[i*3+j];
+    orientation[o].q=glm::quat_cast(r);
+  }
+}
+/* block.key as a Move */
+int roll_move()
+{
+  return (const char *)memchr(move_key,block.key,4)-move_key;
+}
+/* Where the block turns about when rolling towards block.key, from its centre */
+glm::vec3 roll_pivot()
+{
+  if(block.key=='R')
+    return glm::vec3(block.length/2,-block.height/2,0);
+  if(block.key=='L')
+    return glm::vec3(-block.length/2,-block.height/2,0);
+  if(block.key=='U')
+    return glm::vec3(0,-block.height/2,-block.breadth/2);
+  return glm::vec3(0,-block.height/2,block.breadth/2);
+}
 void moveBlock(glm::mat4 VP)
 {
   glm::mat4 MVP;
-  Matrices.model = glm::mat4(1.0f);
+  glm::quat q=orientation[block.orient].q;
+  glm::vec3 centre(block.x_pos,block.y_pos,block.z_pos);
+  if(block.angle!=0)
+  {
+    // Mid roll or tumbling off: turn the resting pose about the pivot edge
+    const int *a=roll_axis[roll_move()];
+    double h=block.angle*M_PI/360;
+    glm::quat turn((float)cos(h),(float)sin(h)*a[0],(float)sin(h)*a[1],(float)sin(h)*a[2]);
+    glm::vec3 pivot=roll_pivot();
+    centre+=pivot-turn*pivot;
+    q=turn*q;
+  }
+  Matrices.model = glm::mat4_cast(q);
+  Matrices.model[3] = glm::vec4(centre,1);
+  MVP = VP * Matrices.model;
+  glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
+  // draw3DObject draws the VAO given to it using current MVP matrix
+  if(block.cuboid!=NULL&&!block_view)
+    draw3DObject(block.cuboid);
+}
+/* Whether a chunk's tiles may be on screen: its box is not wholly outside
+   one side of the clip volume. The box leaves room for a tile's size, a
+   turning bridge half and a tile dropping for a while */
+bool chunk_visible(const glm::mat4 &VP,const TileChunk *c)
+{
+  int out[6]={0};
+  for(int i=0;i<8;i++)
+  {
+    glm::vec4 p=VP*glm::vec4(i&1 ? c->x1+0.5f : c->x0-0.5f,i&2 ? 1.0f : -2.0f,i&4 ? c->z1+0.5f : c->z0-0.5f,1.0f);
+    out[0]+=p.x<-p.w;out[1]+=p.x>p.w;
+    out[2]+=p.y<-p.w;out[3]+=p.y>p.w;
+    out[4]+=p.z<-p.w;out[5]+=p.z>p.w;
+  }
+  for(int k=0;k<6;k++)
+    if(out[k]==8)
+      return false;
+  return true;
+}
+/* Instances first to first+n-1. 3.3 has no base instance, so the per
+   instance attributes are pointed at the first one */
+void drawInstances(int first,int n)
+{
+  glBindBuffer(GL_ARRAY_BUFFER,board.instance_buffer);
+  glVertexAttribPointer(2,4,GL_FLOAT,GL_FALSE,7*sizeof(GLfloat),(void*)(7*(size_t)first*sizeof(GLfloat)));
+  glVertexAttribPointer(3,3,GL_FLOAT,GL_FALSE,7*sizeof(GLfloat),(void*)((7*(size_t)first+4)*sizeof(GLfloat)));
+  glBindBuffer(GL_ARRAY_BUFFER,board.anim_buffer);
+  glVertexAttribPointer(4,4,GL_FLOAT,GL_FALSE,0,(void*)(4*(size_t)first*sizeof(GLfloat)));
+  glDrawArraysInstanced(board.tiles->PrimitiveMode, 0, board.tiles->NumVertices, n);
+}
+/* The chunks in view and the bridge halves, the animations run in the shader.
+   Chunks next to each other in instance order go in one call, so a board
+   in full view is still drawn in one */
+void moveBoard(glm::mat4 VP)
+{
+  const TileStore *t=board.store;
+  int first=0,n=0;
+  glUseProgram(board.programID);
+  glUniformMatrix4fv(board.MatrixID, 1, GL_FALSE, &VP[0][0]);
+  glUniform1f(board.TimeID,(GLfloat)(sim_time-board.spawn_time));
+  glPolygonMode(GL_FRONT_AND_BACK, board.tiles->FillMode);
+  glBindVertexArray(board.tiles->VertexArrayID);
+  for(int i=0;i<t->no_of_chunks;i++)
+  {
+    const TileChunk *c=&t->chunk[i];
+    if(c->count==0||!chunk_visible(VP,c))
+      continue;
+    if(n>0&&first+n!=c->first)
+    {
+      drawInstances(first,n);
+      n=0;
+    }
+    if(n==0)
+      first=c->first;
+    n+=c->count;
+  }
+  if(n>0)
+    drawInstances(first,n);
+  if(bridge[0].shown&&t->count>t->no_of_tiles)
+    drawInstances(t->no_of_tiles,2*min(playing->lvl.no_of_bridges,2));
+  glUseProgram(programID);
+}
+void level_over(void *);
+/* The block left the board: fall, sink through a broken tile or into the goal */
+void start_fall()
+{
+  double now=sim_time,d;
+  if(block.fall_status==1)
+  {
+    d=(block.y_pos+FALL_DEPTH)/FALL_SPEED;
+    tl_add(&timeline,&block.angle,block.angle,block.angle+200*d,now,d,EASE_LINEAR,NULL,NULL);
+    tl_add(&timeline,&block.y_pos,block.y_pos,-FALL_DEPTH,now,d,EASE_IN,level_over,NULL);
+  }
+  else if(block.fall_status==3||block.fall_status==5)
+  {
+    d=(block.y_pos+FALL_DEPTH)/SINK_SPEED;
+    tl_add(&timeline,&block.y_pos,block.y_pos,-FALL_DEPTH,now,d,EASE_IN,level_over,NULL);
+  }
+}
+/* A roll of 90 degrees ended: commit it and see where the block stands */
+void rolled(void *)
+{
+  block.orient=orientation[block.orient].next[roll_move()];
+  block.angle=0;
+  settle();
+  hint_angle=-1;
   if(block.key=='R')
   {
-    block.r_x=-block.length/2;block.r_y=block.height/2;block.r_z=0;
-    block.rotate_vector=glm::vec3(0,0,-1);
+    block.x_pos +=block.length/2+block.height/2;
+    block.y_pos=block.length/2;
+    swap(block.length,block.height);
   }
   if(block.key=='L')
   {
-    block.r_x=block.length/2;block.r_y=block.height/2;block.r_z=0;
-    block.rotate_vector=glm::vec3(0,0,1);
+    block.x_pos-=block.length/2+block.height/2;
+    block.y_pos=block.length/2;
+    swap(block.length,block.height);
   }
   if(block.key=='U')
   {
-    block.r_x=0;block.r_y=block.height/2;block.r_z=block.breadth/2;
-    block.rotate_vector=glm::vec3(-1,0,0);
+    block.z_pos-=block.breadth/2+block.height/2;
+    block.y_pos=block.breadth/2;
+    swap(block.breadth,block.height);
   }
   if(block.key=='D')
   {
-    block.r_x=0;block.r_y=block.height/2;block.r_z=-block.breadth/2;
-    block.rotate_vector=glm::vec3(1,0,0);
+    block.z_pos+=block.breadth/2+block.height/2;
+    block.y_pos=block.breadth/2;
+    swap(block.breadth,block.height);
   }
-  glm::mat4 translateRectangle = glm::translate (glm::vec3(-block.r_x,-block.r_y,-block.r_z));        // glTranslatef
-  translateRectangle*=glm::translate (glm::vec3(block.x_pos,block.y_pos,block.z_pos));
-  glm::mat4 rotateRectangle = glm::rotate((float)(block.angle*M_PI/180.0f), block.rotate_vector); // rotate about vector (-1,1,1)
-  glm::mat4 translateRectangle1 = glm::translate (glm::vec3(block.r_x,block.r_y,block.r_z));
-  Matrices.model *= (translateRectangle*rotateRectangle*translateRectangle1*block.rotation_matrix);
-  MVP = VP * Matrices.model;
-  glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-  // draw3DObject draws the VAO given to it using current MVP matrix
-  if(block.cuboid!=NULL&&!block_view)
-    draw3DObject(block.cuboid);
-  if(block.angle>=90&&block.fall_status==0)
+  Check_Block_Pos();
+  start_fall();
+}
+void roll(char key)
+{
+  if(hang||block.fall_status!=0||block.cuboid==NULL)
+    return;
+  hang=true;
+  block.key=key;
+  tl_add(&timeline,&block.angle,0,90,sim_time,ROLL_SECONDS,EASE_LINEAR,rolled,NULL);
+}
+/* Start the oldest queued roll once the block is free, so queued rolls run back to back */
+void play_input()
+{
+  InputEvent e;
+  if(!hang&&block.fall_status==0&&block.cuboid!=NULL&&iq_pop(&input,&e,glfwGetTime()))
   {
-    block.angle=0;
-    hang=false;
-    block.rotation_matrix=rotateRectangle*block.rotation_matrix;
-    if(block.key=='R')
-    {
-      block.x_pos +=block.length/2+block.height/2;
-      block.y_pos=block.length/2;
-      swap(block.length,block.height);
-    }
-    if(block.key=='L')
-    {
-      block.x_pos-=block.length/2+block.height/2;
-      block.y_pos=block.length/2;
-      swap(block.length,block.height);
-    }
-    if(block.key=='U')
-    {
-      block.z_pos-=block.breadth/2+block.height/2;
-      block.y_pos=block.breadth/2;
-      swap(block.breadth,block.height);
-    }
-    if(block.key=='D')
+    roll(e.key);
+    pending_input=e.time;
+  }
+}
+/* Feed the events of a replay due at this tick */
+void play_replay()
+{
+  while(replay_next<replay.event.size()&&replay.event[replay_next].tick<=tick)
+  {
+    const ReplayEvent *e=&replay.event[replay_next++];
+    switch(e->type)
     {
-      block.z_pos+=block.breadth/2+block.height/2;
-      block.y_pos=block.breadth/2;
-      swap(block.breadth,block.height);
+      case REPLAY_ROLL: queue_roll(move_key[e->move]); break;
+      case REPLAY_KEY: key_event(e->code,e->action); break;
+      case REPLAY_MOUSE: mouse_event(e->button,e->action,e->x,e->y); break;
+      case REPLAY_CHAR: char_event(e->code); break;
+      case REPLAY_END: quit(window); break;
     }
-    Check_Block_Pos();
   }
 }
-void moveBoard(glm::mat4 VP)
+/* Read the input and advance the game to now */
+/* Put this tick's state in the observation ring for agents in other processes */
+void publish_state()
 {
-  glm::mat4 MVP;
-  glm::mat4 translateTriangle;
-  glm::mat4 rotateTriangle;
-  int x,z;
-  for(int i=0;i<board.tiles_created;i+=2)
+  uint8_t *tile;
+  SimState s;
+  ObsFrame *f=obs_ring_begin(&share,&tile);
+  block_state(&s);
+  f->tick=tick;
+  f->level=LEVEL;
+  // The level's own shape, as blox_tool replay -share publishes it
+  const Level *lvl=&playing->lvl;
+  f->width=f->depth=0;
+  if((uint64_t)lvl->width*lvl->depth<=share.h->max_cells)
   {
-        x=board.tile_order[i];z=board.tile_order[i+1];
-        Matrices.model = glm::mat4(1.0f);
-        translateTriangle = glm::translate (glm::vec3(board.tile_xpos[x][z],board.tile_ypos[x][z],board.tile_zpos[x][z]));
-        rotateTriangle = glm::rotate((float)(((board.tile_order[i]+board.tile_order[i+1])%2)*90*M_PI/180.0f),
-                                        glm::vec3(0,1,0));
-        Matrices.model *= translateTriangle*rotateTriangle;
-        MVP = VP * Matrices.model; // MVP = p * V * M
-        glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-        draw3DObject(board.tile[x][z]);
-    }
+    f->width=lvl->width;f->depth=lvl->depth;
+    for(int x=0;x<lvl->width;x++)
+      for(int z=0;z<lvl->depth;z++)
+        tile[x*lvl->depth+z]=tile_type(x,z);
+  }
+  f->x=s.x;f->z=s.z;f->orient=s.orient;
+  f->bridges=s.bridges;
+  f->cube=block.orient;
+  f->fall_status=block.fall_status;
+  f->moving=hang;
+  f->no_of_bridges=min(playing->lvl.no_of_bridges,2);
+  for(int i=0;i<MAX_BRIDGES;i++)
+    f->bridge_angle[i]=i<f->no_of_bridges ? bridge[i].angle : 0;
+  obs_ring_publish(&share);
+}
+void simulate()
+{
+  alloc_scope_begin(&alloc_simulate,"simulate",false);
+  glfwPollEvents();
+  // Every animation advances by the time passed, whatever the frame rate,
+  // in whole ticks
+  while(clock_origin+(tick+1)*TICK<=glfwGetTime())
+  {
+    if(replaying)
+      play_replay();
+    tick++;
+    sim_time=tick*TICK;
+    tl_update(&timeline,sim_time);
+    play_input();
+    if(share.h!=NULL)
+      publish_state();
+  }
+  alloc_scope_end(&alloc_simulate);
+}
+void keep_latency(std::vector<double> *v,double t)
+{
+  if(v->size()<LATENCY_ROLLS)
+    v->push_back(t);
+  else if(v==&latency_submit)
+    latency_unkept++;
+}
+/* The oldest frame in flight finished on the GPU, after waiting at most timeout ns */
+bool retire_frame(GLuint64 timeout)
+{
+  FrameMark *f=&frame_mark[first_mark];
+  GLenum status=glClientWaitSync(f->fence,GL_SYNC_FLUSH_COMMANDS_BIT,timeout);
+  if(status==GL_TIMEOUT_EXPIRED)
+    return false;
+  if(f->input_time>=0&&status!=GL_WAIT_FAILED)
+    keep_latency(&latency_done,glfwGetTime()-f->input_time);
+  glDeleteSync(f->fence);
+  first_mark=(first_mark+1)%MAX_FRAME_MARKS;
+  no_of_marks--;
+  return true;
+}
+/* Swap the frame just drawn and fence it if anyone will wait for it */
+void present(GLFWwindow *window)
+{
+  alloc_scope_begin(&alloc_present,"present",false);
+  double now=glfwGetTime();
+  if(pending_input>=0)
+    keep_latency(&latency_submit,now-pending_input);
+  glfwSwapBuffers(window);
+  now=glfwGetTime();
+  if(pending_input>=0)
+    keep_latency(&latency_swap,now-pending_input);
+  if(pending_input>=0||max_frames_in_flight>0)
+  {
+    while(no_of_marks==MAX_FRAME_MARKS)
+      retire_frame(1000000000);
+    FrameMark f={glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE,0),pending_input};
+    frame_mark[(first_mark+no_of_marks++)%MAX_FRAME_MARKS]=f;
+  }
+  pending_input=-1;
+  while(no_of_marks>0&&retire_frame(0))
+    ;
+  alloc_scope_end(&alloc_present);
+}
+/* Low latency mode: let the GPU catch up before input is read */
+void limit_frames()
+{
+  while(no_of_marks>=max_frames_in_flight)
+    retire_frame(1000000000);
+}
+void print_percentiles(const char *what,std::vector<double> *v)
+{
+  if(v->empty())
+    return;
+  std::sort(v->begin(),v->end());
+  size_t n=v->size();
+  fprintf(stderr,"  %-10s %6.1f %6.1f %6.1f %6.1f ms  (%zu rolls)\n",what,
+          (*v)[n/2]*1e3,(*v)[n*9/10]*1e3,(*v)[n*99/100]*1e3,(*v)[n-1]*1e3,n);
+}
+void report_latency()
+{
+  if(latency_submit.empty())
+    return;
+  fprintf(stderr,"input to photon, p50 p90 p99 max:\n");
+  print_percentiles("submitted",&latency_submit);
+  print_percentiles("swapped",&latency_swap);
+  print_percentiles("gpu done",&latency_done);
+  if(latency_unkept>0)
+    fprintf(stderr,"  %llu later rolls not kept\n",(unsigned long long)latency_unkept);
+}
+uint64_t allocs_outside_levels()
+{
+  AllocCount now;
+  alloc_read(&now);
+  return now.allocs-alloc_level.count.allocs;
+}
+/* End of a frame: did anything but a level load allocate in it? */
+void count_allocs()
+{
+  if(!alloc_tracking())
+    return;
+  uint64_t outside=allocs_outside_levels();
+  alloc_frames++;
+  if(outside>alloc_outside)
+    alloc_frames_allocating++;
+  alloc_outside=outside;
+}
+void report_allocs()
+{
+  AllocCount now;
+  if(!alloc_tracking())
+    return;
+  alloc_read(&now);
+  fprintf(stderr,"heap: %llu allocations, %llu bytes; %llu of %llu frames allocated outside level loads\n",
+          (unsigned long long)now.allocs,(unsigned long long)now.bytes,
+          (unsigned long long)alloc_frames_allocating,(unsigned long long)alloc_frames);
+  const AllocScope *scope[4]={&alloc_level,&alloc_simulate,&alloc_draw,&alloc_present};
+  for(int i=0;i<4;i++)
+    if(scope[i]->name!=NULL)
+      fprintf(stderr,"  %-10s %8llu allocations %10llu bytes\n",scope[i]->name,
+              (unsigned long long)scope[i]->count.allocs,(unsigned long long)scope[i]->count.bytes);
 }
 void draw_Arrow(glm::mat4 VP,double angle,VAO *object)
 {
@@ -737,6 +1356,7 @@ float triangle_rotation = 0;
 /* Edit this function according to your assignment */
 void draw ()
 {
+  alloc_scope_begin(&alloc_draw,"draw",false);
   // clear the color and depth in the frame buffer
   glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -759,6 +1379,11 @@ void draw ()
   draw_Arrow(VP1,180,rectangle);
   draw_Arrow(VP1,270,triangle);
   draw_Arrow(VP1,270,rectangle);
+  if(hint_angle>=0)
+  {
+    draw_Arrow(VP1,hint_angle,hint_triangle);
+    draw_Arrow(VP1,hint_angle,hint_rectangle);
+  }
 
   GLfloat fov = 90.0f;
   if(ortho)
@@ -823,15 +1448,11 @@ void draw ()
                        glm::vec3(block.x_pos+x_direction,block.y_pos,block.z_pos+z_direction), glm::vec3(0,1,0));
   }
   moveBoard(VP*scale*translateTriangle);
-  if(bridge[0].bridge[0]!=NULL)
-  {
-    moveBridge(bridge[0],VP*scale*translateTriangle);
-    moveBridge(bridge[1],VP*scale*translateTriangle);
-  }
   // Pop matrix to undo transformations till last push matrix instead of recomputing model matrix
   // glPopMatrix ();
   if(block.cuboid!=NULL&&!block_view)
     moveBlock(VP*scale*translateTriangle);
+  alloc_scope_end(&alloc_draw);
 
   // Increment angles
   //float increments = 1;
@@ -866,7 +1487,7 @@ GLFWwindow* initGLFW (int width, int height)
 
     glfwMakeContextCurrent(window);
     gladLoadGLLoader((GLADloadproc) glfwGetProcAddress);
-    glfwSwapInterval( 1 );
+    glfwSwapInterval( swap_interval );
 
     /* --- register callbacks with GLFW --- */
 
@@ -897,15 +1518,28 @@ void initGL (GLFWwindow* window, int width, int height)
 	// Create the models
 	createTriangle (); // Generate the VAO, VBOs, vertices data & copy into the array buffer
   createRectangle();
+  createHintArrow();
+  createMeshes();
+  createOrientations();
 	// Create and compile our GLSL program from the shaders
 	programID = LoadShaders( "Sample_GL.vert", "Sample_GL.frag" );
 	// Get a handle for our "MVP" uniform
 	Matrices.MatrixID = glGetUniformLocation(programID, "MVP");
+  board.programID = LoadShaders( "Tile_GL.vert", "Sample_GL.frag" );
+  board.MatrixID = glGetUniformLocation(board.programID, "MVP");
+  board.TimeID = glGetUniformLocation(board.programID, "time");
 
   Matrices.view=glm::lookAt(glm::vec3(-2,3,4), glm::vec3(0,0,0), glm::vec3(0,1,0));
   ortho=true;
   x_direction=0;z_direction=1;
-  reshapeWindow (window, width, height);
+  // Without a window (the benchmarks) the caller's framebuffer is width x height
+  if(window!=NULL)
+    reshapeWindow (window, width, height);
+  else
+  {
+    fbwidth=width;fbheight=height;
+    glViewport (0, 0, width, height);
+  }
 
   // Background color of the scene
 	glClearColor (0.3f, 0.3f, 0.3f, 0.0f); // R, G, B, A
@@ -919,205 +1553,568 @@ void initGL (GLFWwindow* window, int width, int height)
     cout << "VERSION: " << glGetString(GL_VERSION) << endl;
     cout << "GLSL: " << glGetString(GL_SHADING_LANGUAGE_VERSION) << endl;
 }
-void initialize(int *tile_pos,int n)
+/* Start the spawn animation of every tile. Any size of level can be drawn */
+void spawn_tiles(TileStore *t)
 {
-  for(int i=0;i<14;i++)
-    for(int j=0;j<14;j++)
-      board.tile_type[i][j]=0;
-  for(int i=0;i<400;i++)
-    board.tile_order[i]=0;
-  board.no_of_tiles=n/2;
-  for(int i=0;i<n;i++)
-    board.tile_order[i]=tile_pos[i];
-  for(int i=0;i<n;i+=2)
-      board.tile_type[tile_pos[i]][tile_pos[i+1]]=1;
+  board.store=t;
+  board.no_of_tiles=t->no_of_tiles;
+  glBindBuffer(GL_ARRAY_BUFFER,board.anim_buffer);
+  if(t->count>board.anim_capacity)
+  {
+    board.anim_capacity=t->count;
+    glBufferData(GL_ARRAY_BUFFER,(size_t)board.anim_capacity*4*sizeof(GLfloat),NULL,GL_DYNAMIC_DRAW);
+  }
+  // Tile k spawns 0.1*(k+1) s in, without the CPU touching it again
+  GLfloat *anim=arena_array<GLfloat>(&frame_arena,4*(size_t)t->no_of_tiles+1);
+  for(int k=0;k<t->no_of_tiles;k++)
+  {
+    anim[4*k]=SPAWN_SECONDS*(t->spawn[k]+1);
+    anim[4*k+1]=ANIM_SPAWN;
+    anim[4*k+2]=anim[4*k+3]=0;
+  }
+  glBufferSubData(GL_ARRAY_BUFFER,0,4*(size_t)t->no_of_tiles*sizeof(GLfloat),anim);
+  board.spawn_time=sim_time;
 }
-void level_init(int level)
+void initialize(TileStore *t)
 {
-  switch (level)
+  if(board.store==t)
   {
-    case 1:
+    // Playing the level again: only the chunks played on and the bridges changed
+    for(int i=0;i<t->no_of_chunks;i++)
+      if(t->chunk[i].dirty)
+      {
+        const TileChunk *c=&t->chunk[i];
+        memcpy(&board.type[c->first],&t->type[c->first],c->count);
+        t->chunk[i].dirty=false;
+      }
+    memcpy(&board.type[t->no_of_tiles],&t->type[t->no_of_tiles],t->entries-t->no_of_tiles);
+  }
+  else
+  {
+    board.type.assign(t->type,t->type+t->entries);
+    for(int i=0;i<t->no_of_chunks;i++)
+      t->chunk[i].dirty=false;
+  }
+  spawn_tiles(t);
+}
+/* Levels come from the pack when there is one, else levels/levelN.blv or
+   levels/levelN.txt, else the built-in copies */
+int read_level(int level,LevelSlot *slot)
+{
+  char path[64];
+  slot->level=0;
+  level_file_unmap(&slot->map);
+  hint_table_free(&slot->hints);
+  arena_reset(&slot->arena);
+  if(pack.map!=NULL)
+  {
+    level_pack_prefetch(&pack,level);
+    if(level_pack_level(&pack,level,&slot->lvl))
     {
-      int tile_pos[]={3,3,3,4,3,5,4,5,5,5,4,6,5,6,6,6,6,5,6,4,7,5,7,4,7,3,8,3,8,2,9,3,9,2,10,3,10,4,10,5,
-                      9,5,11,5,10,6,10,7,10,8,9,7,9,8,9,9,8,9,7,9,7,10,6,10,5,10,5,9,5,8,6,8,7,8};
-      initialize(tile_pos,74);
-      block.x_pos=3/2.0;block.z_pos=5/2.0;
-      block.x_destination=6;block.z_destination=9;
-      board.tile_type[6][9]=1;
-      break;
+      if(level_fits_board(&slot->lvl))
+      {
+        slot->level=level;
+        return 1;
+      }
+      fprintf(stderr,"Level %d of the pack does not fit the 14x14 board\n",level);
     }
-    case 2:
+  }
+  snprintf(path,sizeof(path),"levels/level%d.blv",level);
+  if(level_file_map(path,&slot->map))
+  {
+    if(level_fits_board(&slot->map.lvl))
     {
-      int tile_pos[]={4,10,5,10,5,11,4,11,3,11,3,10,3,9,4,9,2,10,5,9,6,10,7,10,8,10,9,10,8,9,9,9,8,8,9,8,10,8,10,7,
-        10,6,10,5,10,4,11,4,9,4,9,3,10,3,11,3,9,2,10,2,11,2,8,3,8,4,7,3,7,4,6,4,5,4,4,4,4,5,4,6,3,5,3,6,2,5,2,6,
-        2,4,2,3,3,3,4,3};
-      initialize(tile_pos,96);
-      board.tile_type[10][4]=2;board.tile_type[11][4]=2;board.tile_type[9][4]=2;board.tile_type[9][3]=2;
-      board.tile_type[10][3]=2;board.tile_type[11][3]=2;board.tile_type[9][2]=2;board.tile_type[10][2]=2;
-      block.x_pos=4/2.0;block.z_pos=10/2.0;
-      block.x_destination=3;block.z_destination=4;
-      board.tile_type[3][4]=1;
-      break;
+      slot->lvl=slot->map.lvl;
+      slot->level=level;
+      return 1;
     }
-    case 3:
+    fprintf(stderr,"%s does not fit the 14x14 board\n",path);
+    level_file_unmap(&slot->map);
+  }
+  snprintf(path,sizeof(path),"levels/level%d.txt",level);
+  slot->parse.tile=arena_array<uint8_t>(&slot->arena,14*14);
+  slot->parse.order=arena_array<int16_t>(&slot->arena,2*14*14);
+  slot->parse.capacity=14*14;
+  if(level_read_text(path,&slot->parse,&slot->lvl))
+  {
+    if(level_fits_board(&slot->lvl))
     {
-      int tile_pos[]={4,4,4,5,3,5,3,4,3,3,4,3,2,4,5,3,5,4,5,5,/*6,4,7,4,*/8,4,9,4,8,5,9,5,9,6,8,6,7,6,7,7,8,7,9,7,9,8,
-        8,8,7,8,7,9,8,9,9,9,/*6,8,5,8,*/4,8,4,9,3,9,2,9,2,8,2,7,3,7,4,7
-      };
-      initialize(tile_pos,68);
-      bridge[0].x_pos[0]=6;bridge[0].z_pos[0]=4;bridge[0].x_pos[1]=7;bridge[0].z_pos[1]=4;
-      bridge[1].x_pos[0]=5;bridge[1].z_pos[0]=8;bridge[1].x_pos[1]=6;bridge[1].z_pos[1]=8;
-      block.x_pos=4/2.0;block.z_pos=4/2.0;
-      block.x_destination=3;block.z_destination=8;
-      board.tile_type[3][8]=1;
-      board.tile_type[2][4]=3;
-      board.tile_type[9][7]=4;
-      break;
+      slot->level=level;
+      return 1;
     }
+    fprintf(stderr,"%s does not fit the 14x14 board\n",path);
+  }
+  else if(slot->parse.line>0)
+    fprintf(stderr,"%s: %s\n",path,slot->parse.error);
+  if(!builtin_level(level,&slot->lvl))
+    return 0;
+  slot->level=level;
+  return 1;
+}
+/* Read a level and lay out its tiles. Runs on either thread */
+int load_level(int level,LevelSlot *slot)
+{
+  if(!read_level(level,slot))
+    return 0;
+  tile_store_build(&slot->tiles,&slot->lvl,&slot->arena);
+  return 1;
+}
+/* Hints from the pack, else the cached levelN.hint, else build and cache them */
+void load_hints(LevelSlot *slot)
+{
+  char path[64];
+  uint32_t hash=level_hash(&slot->lvl);
+  if(pack.map!=NULL&&level_pack_hints(&pack,slot->level,&slot->hints)&&slot->hints.level_hash==hash)
+    return;
+  snprintf(path,sizeof(path),"level%d.hint",slot->level);
+  if(hint_table_map(path,hash,&slot->hints))
+    return;
+  hint_table_build(&slot->lvl,&slot->hints);
+  if(!hint_table_save(&slot->hints,path))
+    fprintf(stderr,"Could not write %s\n",path);
+}
+/* Upload the place and color of every tile, in spawn order, then of the bridge halves */
+void upload_level(LevelSlot *slot,bool fence)
+{
+  const TileStore *t=&slot->tiles;
+  size_t size=7*(size_t)t->count*sizeof(GLfloat);
+  GLfloat *d=arena_array<GLfloat>(&slot->arena,size/sizeof(GLfloat)+1),*data=d;
+  for(int k=0;k<t->no_of_tiles;k++,d+=7)
+  {
+    int type=t->type[k];
+    d[0]=t->x[k];d[1]=-0.2/2.0;d[2]=t->z[k];d[3]=1;
+    cuboid_color(type==1 ? 0 : type,d+4);
+  }
+  // Each half hinges on its outer bottom edge and is half as thick as a tile
+  for(int k=t->no_of_tiles;k<t->count;k++,d+=7)
+  {
+    d[0]=t->x[k]+((k-t->no_of_tiles)%2 ? 0.25f : -0.25f);d[1]=-0.1;d[2]=t->z[k];d[3]=0.5;
+    cuboid_color(1,d+4);
+  }
+  glGenBuffers(1,&slot->instance_buffer);
+  glBindBuffer(GL_ARRAY_BUFFER,slot->instance_buffer);
+  glBufferData(GL_ARRAY_BUFFER,size,data,GL_STATIC_DRAW);
+  if(fence)
+  {
+    // The game's context waits on this before it draws from the buffers
+    slot->uploaded=glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE,0);
+    glFlush();
   }
 }
-void toggleBridge(struct Bridge *bridge)
+/* Main thread only: buffers may be in use by the game's VAOs until then */
+void release_gpu(LevelSlot *slot)
 {
-  if(bridge->bridge_status&&bridge->angle>0)
+  if(slot->instance_buffer!=0)
+    glDeleteBuffers(1,&slot->instance_buffer);
+  if(slot->uploaded!=NULL)
+    glDeleteSync(slot->uploaded);
+  slot->instance_buffer=0;
+  slot->uploaded=NULL;
+}
+int count_levels()
+{
+  char path[64];
+  Level lvl;
+  if(pack.map!=NULL)
+    return pack.count;
+  int n=0;
+  for(;;n++)
   {
-    bridge->angle+=5;
-    hang=true;
-    if(bridge->angle==90)
+    snprintf(path,sizeof(path),"levels/level%d.blv",n+1);
+    if(access(path,R_OK)==0)
+      continue;
+    snprintf(path,sizeof(path),"levels/level%d.txt",n+1);
+    if(access(path,R_OK)==0||builtin_level(n+1,&lvl))
+      continue;
+    return n;
+  }
+}
+LevelSlot *other_slot()
+{
+  return &level_slot[playing==&level_slot[0]];
+}
+void loader_main()
+{
+  if(loader_window!=NULL)
+    glfwMakeContextCurrent(loader_window);
+  std::unique_lock<std::mutex> lock(loader_mutex);
+  for(;;)
+  {
+    loader_cv.wait(lock,[]{return prefetch_request!=0||loader_quit;});
+    if(loader_quit)
+      break;
+    int level=prefetch_busy=prefetch_request;
+    LevelSlot *slot=other_slot();
+    prefetch_request=0;
+    lock.unlock();
+    if(load_level(level,slot))
     {
-      board.tile_type[(int)bridge->x_pos[0]][(int)bridge->z_pos[0]]=0;
-      board.tile_type[(int)bridge->x_pos[1]][(int)bridge->z_pos[1]]=0;
-      bridge->bridge_status=false;
-      hang=false;
+      load_hints(slot);
+      if(loader_window!=NULL)
+        upload_level(slot,true);
     }
+    lock.lock();
+    prefetch_busy=0;
+    loader_cv.notify_all();
+  }
+  if(loader_window!=NULL)
+    glfwMakeContextCurrent(NULL);
+}
+/* Windows have to be created on the main thread, so the loader's is made here */
+void start_loader(GLFWwindow *window)
+{
+  glfwWindowHint(GLFW_VISIBLE,GLFW_FALSE);
+  loader_window=glfwCreateWindow(1,1,"loader",NULL,window);
+  glfwWindowHint(GLFW_VISIBLE,GLFW_TRUE);
+  if(loader_window==NULL)
+    fprintf(stderr,"No shared context, levels will be uploaded when they start\n");
+  loader=std::thread(loader_main);
+}
+void stop_loader()
+{
+  if(!loader.joinable())
+    return;
+  {
+    std::lock_guard<std::mutex> lock(loader_mutex);
+    loader_quit=true;
   }
-  else if(!bridge->bridge_status&&bridge->angle<90)
+  loader_cv.notify_all();
+  loader.join();
+  if(loader_window!=NULL)
+    glfwDestroyWindow(loader_window);
+  loader_window=NULL;
+}
+/* Load, page in and upload the level in the background, e.g. while the win animation plays */
+void prefetch_level(int level)
+{
+  if(!loader.joinable()||level>no_of_levels)
+    return;
+  std::lock_guard<std::mutex> lock(loader_mutex);
+  LevelSlot *slot=other_slot();
+  if(prefetch_busy!=0||prefetch_request!=0||slot->level==level)
+    return;
+  release_gpu(slot);
+  slot->level=0;
+  prefetch_request=level;
+  loader_cv.notify_all();
+}
+void level_init(int level)
+{
+  LevelSlot *next=other_slot();
+  // Loading is the one place a frame may allocate
+  alloc_scope_begin(&alloc_level,"level",true);
+  if(playing->level!=level)
   {
-    bridge->angle-=5;
-    hang=true;
-    if(bridge->angle==0)
     {
-      board.tile_type[(int)bridge->x_pos[0]][(int)bridge->z_pos[0]]=1;
-      board.tile_type[(int)bridge->x_pos[1]][(int)bridge->z_pos[1]]=1;
-      bridge->bridge_status=true;
-      hang=false;
+      std::unique_lock<std::mutex> lock(loader_mutex);
+      loader_cv.wait(lock,[]{return prefetch_request==0&&prefetch_busy==0;});
+    }
+    if(next->level!=level)
+    {
+      release_gpu(next);
+      if(!load_level(level,next))
+      {
+        alloc_scope_end(&alloc_level);
+        return;
+      }
+      load_hints(next);
     }
+    if(next->instance_buffer==0)
+      upload_level(next,false);
+    if(next->uploaded!=NULL)
+    {
+      glWaitSync(next->uploaded,0,GL_TIMEOUT_IGNORED);
+      glDeleteSync(next->uploaded);
+      next->uploaded=NULL;
+    }
+    playing=next;
+    attachInstances(playing->instance_buffer);
   }
+  initialize(&playing->tiles);
+  for(int i=0;i<playing->lvl.no_of_bridges&&i<2;i++)
+  {
+    const SimBridge *b=&playing->lvl.bridge[i];
+    bridge[i].x_pos[0]=b->x[0];bridge[i].z_pos[0]=b->z[0];
+    bridge[i].x_pos[1]=b->x[1];bridge[i].z_pos[1]=b->z[1];
+  }
+  block.x_pos=playing->lvl.start_x/2.0;block.z_pos=playing->lvl.start_z/2.0;
+  block.x_destination=playing->lvl.goal_x;block.z_destination=playing->lvl.goal_z;
+  block.angle=0;
+  block.fall_status=0;
+  block.cuboid=NULL;
+  bridge[0].shown=bridge[0].turning=false;
+  bridge[1].shown=bridge[1].turning=false;
+  hang=false;
+  hint_angle=-1;
+  iq_clear(&input);
+  tl_clear(&timeline);
+  tl_add(&timeline,NULL,0,0,board.spawn_time,SPAWN_SECONDS*playing->lvl.no_of_tiles,EASE_LINEAR,spawned,NULL);
+  alloc_scope_end(&alloc_level);
 }
+void level_over(void *)
+{
+  if(block.fall_status==5)
+  {
+    if(LEVEL==no_of_levels)
+      quit(window);
+    level_init(++LEVEL);
+  }
+  else
+    level_init(LEVEL);
+}
+#ifdef BLOX_BENCH
+/* The game's hot paths for blox_bench, on the state they see while playing */
+static GLfloat bench_vertex[108],bench_color[108];
+static void bench_cuboid(void *)
+{
+  cuboid_data(0.5,1,0.5,5,bench_vertex,bench_color);
+}
+static void bench_read_shader(void *arg)
+{
+  std::string code;
+  read_shader((const char *)arg,&code);
+}
+/* Every resting pose on level 1's board, falls and the goal included */
+struct BenchPose { double x,z; int orient; };
+static vector<BenchPose> bench_pose;
+static size_t bench_next;
+static void bench_check(void *)
+{
+  const BenchPose *p=&bench_pose[bench_next++%bench_pose.size()];
+  block.length=block.breadth=0.5;block.height=1;
+  if(p->orient==LYING_X) swap(block.length,block.height);
+  if(p->orient==LYING_Z) swap(block.breadth,block.height);
+  block.x_pos=p->x;block.z_pos=p->z;
+  block.angle=0;block.fall_status=0;
+  Check_Block_Pos();
+}
+static glm::mat4 bench_vp;
+static void bench_move_board(void *)
+{
+  moveBoard(bench_vp);
+}
+static void bench_move_board_finish(void *)
+{
+  moveBoard(bench_vp);
+  glFinish();
+}
+static void bench_draw_finish(void *)
+{
+  draw();
+  glFinish();
+}
+static void bench_level_init(void *)
+{
+  // Three levels through two slots, so each one is loaded and uploaded again
+  arena_reset(&frame_arena);
+  level_init(bench_next++%3+1);
+}
+/* Draw into a window sized framebuffer of our own */
+static void bench_gl(BenchSuite *s)
+{
+  static GLuint fbo,rb[2];
+  if(fbo!=0)
+    return;
+  glGenFramebuffers(1,&fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER,fbo);
+  glGenRenderbuffers(2,rb);
+  glBindRenderbuffer(GL_RENDERBUFFER,rb[0]);
+  glRenderbufferStorage(GL_RENDERBUFFER,GL_RGBA8,600,600);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,GL_RENDERBUFFER,rb[0]);
+  glBindRenderbuffer(GL_RENDERBUFFER,rb[1]);
+  glRenderbufferStorage(GL_RENDERBUFFER,GL_DEPTH_COMPONENT24,600,600);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER,GL_DEPTH_ATTACHMENT,GL_RENDERBUFFER,rb[1]);
+  initGL(NULL,600,600);
+  s->renderer=(const char *)glGetString(GL_RENDERER);
+  tl_init(&timeline);
+  iq_init(&input,8);
+}
+void game_bench(BenchSuite *s,bool gl)
+{
+  // Per element is per vertex, per byte of source, per tile or bridge half
+  std::string code[2];
+  read_shader("Sample_GL.vert",&code[0]);
+  read_shader("Tile_GL.vert",&code[1]);
+  bench_run(s,"cuboid_data",bench_cuboid,NULL,36);
+  bench_run(s,"LoadShaders read Sample_GL.vert",bench_read_shader,(void *)"Sample_GL.vert",code[0].size());
+  bench_run(s,"LoadShaders read Tile_GL.vert",bench_read_shader,(void *)"Tile_GL.vert",code[1].size());
+
+  static Arena arena;
+  static TileStore tiles;
+  Level lvl;
+  builtin_level(1,&lvl);
+  tile_store_build(&tiles,&lvl,&arena);
+  board.store=&tiles;
+  board.type.assign(tiles.type,tiles.type+tiles.entries);
+  block.x_destination=lvl.goal_x;block.z_destination=lvl.goal_z;
+  for(int x=0;x<13;x++)
+    for(int z=0;z<13;z++)
+      for(int o=STANDING;o<=LYING_Z;o++)
+      {
+        BenchPose p={x/2.0+(o==LYING_X)*0.25,z/2.0+(o==LYING_Z)*0.25,o};
+        bench_pose.push_back(p);
+      }
+  bench_next=0;
+  bench_run(s,"Check_Block_Pos",bench_check,NULL,1);
+  if(!gl)
+    return;
+
+  bench_gl(s);
+  level_init(3);
+  sim_time=board.spawn_time+SPAWN_SECONDS*board.no_of_tiles+1;
+  createBlock();
+  bridge[0].shown=bridge[1].shown=true;
+  bench_vp=glm::ortho(-4.0f,4.0f,-4.0f,4.0f,0.1f,500.0f)*Matrices.view;
+  int instances=board.no_of_tiles+2*playing->lvl.no_of_bridges;
+  bench_run(s,"moveBoard",bench_move_board,NULL,instances);
+  bench_run(s,"moveBoard+glFinish",bench_move_board_finish,NULL,instances);
+  bench_run(s,"draw+glFinish",bench_draw_finish,NULL,instances);
+  glFinish();
+  bench_next=0;
+  bench_run(s,"level_init",bench_level_init,NULL,1);
+}
+const char *const scale_view_name[SCALE_VIEWS]={"general","top","tower","follow","helicopter","block"};
+static const int scale_view_key[SCALE_VIEWS]={GLFW_KEY_G,GLFW_KEY_U,GLFW_KEY_T,GLFW_KEY_C,GLFW_KEY_H,GLFW_KEY_B};
+int game_scale(BenchSuite *s,const char *path,ScaleRow *row)
+{
+  static LevelSlot slot;
+  bench_gl(s);
+  chrono::steady_clock::time_point t0=chrono::steady_clock::now();
+  if(!level_file_map(path,&slot.map))
+    return 0;
+  slot.lvl=slot.map.lvl;
+  tile_store_build(&slot.tiles,&slot.lvl,&slot.arena);
+  row->store_bytes=slot.arena.live;
+  chrono::steady_clock::time_point t1=chrono::steady_clock::now();
+  upload_level(&slot,false);
+  attachInstances(slot.instance_buffer);
+  spawn_tiles(&slot.tiles);
+  glFinish();
+  chrono::steady_clock::time_point t2=chrono::steady_clock::now();
+  row->load_ms=chrono::duration<double,milli>(t1-t0).count();
+  row->upload_ms=chrono::duration<double,milli>(t2-t1).count();
+  GLint instance_size,anim_size;
+  glBindBuffer(GL_ARRAY_BUFFER,slot.instance_buffer);
+  glGetBufferParameteriv(GL_ARRAY_BUFFER,GL_BUFFER_SIZE,&instance_size);
+  glBindBuffer(GL_ARRAY_BUFFER,board.anim_buffer);
+  glGetBufferParameteriv(GL_ARRAY_BUFFER,GL_BUFFER_SIZE,&anim_size);
+  row->gpu_bytes=(uint64_t)instance_size+anim_size;
+
+  // Every tile in, the block standing on the start, nothing animating
+  sim_time=board.spawn_time+SPAWN_SECONDS*board.no_of_tiles+1;
+  createBlock();
+  block.fall_status=0;
+  block.x_pos=slot.lvl.start_x/2.0;block.z_pos=slot.lvl.start_z/2.0;
+  block.y_pos=block.height/2;
+  bridge[0].shown=bridge[1].shown=false;
+  hint_angle=-1;
+  x_direction=1;z_direction=0;
+  for(int v=0;v<SCALE_VIEWS;v++)
+  {
+    char name[64];
+    key_event(scale_view_key[v],GLFW_PRESS);
+    snprintf(name,sizeof(name),"draw+glFinish %dx%d %s",slot.lvl.width,slot.lvl.depth,scale_view_name[v]);
+    bench_run(s,name,bench_draw_finish,NULL,board.no_of_tiles);
+    row->frame_ms[v]=s->results.back().median_ns/1e6;
+  }
+  key_event(GLFW_KEY_G,GLFW_PRESS);
+  release_gpu(&slot);
+  level_file_unmap(&slot.map);
+  arena_free(&slot.arena);
+  arena_free(&frame_arena);
+  return 1;
+}
+#else
 int main (int argc, char** argv)
 {
 	int width = 600;
 	int height = 600;
+  int arg=1,queue_depth=8;
+  const char *record_path=NULL;
   fbwidth=width;fbheight=height;
-  hang=false;
   LEVEL=1;
+  for(;arg+1<argc&&argv[arg][0]=='-';arg+=2)
+  {
+    if(strcmp(argv[arg],"-queue")==0)
+      queue_depth=atoi(argv[arg+1]);
+    else if(strcmp(argv[arg],"-swap")==0)
+      swap_interval=atoi(argv[arg+1]);
+    else if(strcmp(argv[arg],"-lowlatency")==0)
+      max_frames_in_flight=min(max(atoi(argv[arg+1]),1),MAX_FRAME_MARKS);
+    else if(strcmp(argv[arg],"-record")==0)
+      record_path=argv[arg+1];
+    else if(strcmp(argv[arg],"-zeroalloc")==0)
+      zero_alloc=atoi(argv[arg+1])!=0;
+    else if(strcmp(argv[arg],"-stats")==0)
+      show_stats=atoi(argv[arg+1])!=0;
+    else if(strcmp(argv[arg],"-share")==0)
+    {
+      if(!obs_ring_create(&share,argv[arg+1],64,14*14))
+        fprintf(stderr,"Could not create the shared memory ring %s\n",argv[arg+1]);
+    }
+    else if(strcmp(argv[arg],"-replay")==0)
+    {
+      if(!replay_load(argv[arg+1],&replay))
+      {
+        fprintf(stderr,"Could not read the replay %s\n",argv[arg+1]);
+        return 1;
+      }
+      replaying=true;
+      LEVEL=replay.header.first_level;
+      queue_depth=replay.header.queue_depth;
+    }
+    else
+      break;
+  }
+  iq_init(&input,queue_depth);
+  // Timings of this many rolls are kept without the frame loop allocating
+  latency_submit.reserve(LATENCY_ROLLS);
+  latency_swap.reserve(LATENCY_ROLLS);
+  latency_done.reserve(LATENCY_ROLLS);
+  hang=false;
   shift=true;
+  arena_init(&frame_arena,"frame",64*1024);
+  arena_init(&level_slot[0].arena,"level slot 0",0);
+  arena_init(&level_slot[1].arena,"level slot 1",0);
 
     GLFWwindow* window = initGLFW(width, height);
 
 	  initGL (window, width, height);
-    double last_update_time = glfwGetTime(),create_tile_time=glfwGetTime(), current_time;
+    if(!level_pack_open(arg<argc ? argv[arg] : "levels/levels.bxp",&pack)&&arg<argc)
+      fprintf(stderr,"Could not open the level pack %s\n",argv[arg]);
+    no_of_levels=count_levels();
+    start_loader(window);
+    tl_init(&timeline);
+    clock_origin=glfwGetTime();
     /* Draw in loop */
     level_init(LEVEL);
-    board.tiles_created=0;
-    bridge[0].bridge[0]=NULL;
+    if(replaying&&replay.header.level_hash!=level_hash(&playing->lvl))
+      fprintf(stderr,"The replay was recorded on another level %d, it will not play the same\n",LEVEL);
+    if(record_path!=NULL&&!replay_create(&recorder,record_path,LEVEL,level_hash(&playing->lvl),input.depth))
+      fprintf(stderr,"Could not write the replay %s\n",record_path);
+    if(zero_alloc&&!alloc_tracking())
+      fprintf(stderr,"-zeroalloc needs a build with BLOX_ALLOC_TRACK, make sample2D_alloc\n");
+    alloc_forbid(zero_alloc);
+    alloc_outside=allocs_outside_levels();
     while (!glfwWindowShouldClose(window)) {
+        arena_reset(&frame_arena);
+        // In low latency mode input is read last thing before drawing,
+        // once the GPU has drained, else right after the swap
+        if(max_frames_in_flight>0)
+        {
+          limit_frames();
+          simulate();
+        }
         // OpenGL Draw commands
         draw();
         // Swap Frame Buffer in double buffering
-        glfwSwapBuffers(window);
+        present(window);
 
-        // Poll for Keyboard and mouse events
-        glfwPollEvents();
-
-        // Control based on time (Time based transformation like 5 degrees rotation every 0.5s)
-        current_time = glfwGetTime(); // Time in seconds
-        if(block.cuboid==NULL&&board.tiles_created==2*board.no_of_tiles)
-          createBlock();
-        if(board.tiles_created<2*board.no_of_tiles&&current_time-create_tile_time>=0.1)
-        {
-          createTile(board.tile_order[board.tiles_created],board.tile_order[board.tiles_created+1]);
-          board.tiles_created+=2;
-          create_tile_time=current_time;
-        }
-        if(board.tiles_created==2*board.no_of_tiles&&bridge[0].bridge[0]==NULL)
-        {
-          createBridge(&bridge[0]);
-          bridge[0].bridge_status=true;
-          createBridge(&bridge[1]);
-          bridge[1].bridge_status=true;
-          bridge[0].angle=5;
-          bridge[1].angle=5;
-        }
-        if ((current_time - last_update_time) >= 0.05) { // atleast 0.5s elapsed since last frame
-            // do something every 0.5 seconds ..
-            if(bridge[0].bridge[0]!=NULL)
-            {
-              toggleBridge(&bridge[0]);
-              toggleBridge(&bridge[1]);
-            }
-            if(block.fall_status==1)
-            {
-                block.angle+=10;
-                if(block.angle>360)
-                  block.angle-=360;
-                block.y_pos-=0.5;
-            }
-            else if(block.fall_status==2)
-            {
-              if(block.y_pos>block.height/2.0)
-                block.y_pos-=0.05;
-              else
-              {
-                hang=false;
-                block.fall_status=0;
-              }
-            }
-            else if(block.fall_status==3)
-            {
-              block.y_pos-=0.25;
-              board.tile_ypos[(int)(block.x_pos*2)][(int)(block.z_pos*2)]-=0.25;
-            }
-            if(block.fall_status==4)
-            {
-                block.angle+=10;
-                if(block.angle>=90)
-                {
-                  block.angle=0;
-                  block.fall_status=1;
-                }
-                if(block.angle>360)
-                  block.angle-=360;
-            }
-            else if(block.fall_status==5)
-              block.y_pos-=0.25;
-            else if(block.angle!=0)
-            {
-                block.angle+=10;
-                hang=true;
-              }
-            last_update_time = current_time;
-        }
-        if(block.y_pos<-3)
-        {
-          if(LEVEL==4)
-            quit(window);
-          if(block.fall_status==1||block.fall_status==3)
-              level_init(LEVEL);
-          if(block.fall_status==5)
-            level_init(++LEVEL);
-          if(block.fall_status==1||block.fall_status==3||block.fall_status==5)
-          {
-            block.angle=0;
-            hang=false;
-            create_tile_time=glfwGetTime();
-            block.cuboid=NULL;
-            bridge[0].bridge[0]=NULL;
-            bridge[1].bridge[0]=NULL;
-            block.fall_status=0;
-            board.tiles_created=0;
-          }
-        }
+        if(max_frames_in_flight==0)
+          simulate();
+        count_allocs();
     }
-    glfwTerminate();
+    quit(window);
 //    exit(EXIT_SUCCESS);
 }
+#endif
@@ -0,0 +1,55 @@
+#version 330 core
+
+// One tile cuboid, drawn once per tile and bridge half
+layout (location = 0) in vec3 vertexPosition;
+layout (location = 1) in vec3 vertexColor;
+
+// Per instance: where it sits and what it looks like, uploaded with the level
+layout (location = 2) in vec4 place;      // xyz tile centre or bridge hinge, w height scale
+layout (location = 3) in vec3 tileColor;
+// Per instance: the running animation, rewritten only when one starts
+layout (location = 4) in vec4 anim;       // start time, kind, from and to angle
+
+uniform mat4 MVP;
+uniform float time;
+
+out vec3 fragColor;
+
+#define SPAWN        0.0
+#define DROP         1.0
+#define BRIDGE_LEFT  2.0
+#define BRIDGE_RIGHT 3.0
+
+void main ()
+{
+    vec3 v = vertexPosition;
+    vec3 p = place.xyz;
+    float t = time - anim.x;
+    v.y *= place.w;
+
+    if (anim.y == SPAWN) {
+        // Not spawned yet: collapse the whole tile outside the clip volume
+        if (t < 0.0) {
+            gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+            fragColor = vec3(0.0);
+            return;
+        }
+    }
+    else if (anim.y == DROP)
+        p.y -= 5.0 * max(t, 0.0);
+    else {
+        // Bridge halves turn about their outer bottom edge at 100 degrees per second
+        float s = anim.y == BRIDGE_LEFT ? -1.0 : 1.0;
+        float span = abs(anim.w - anim.z);
+        float k = span > 0.0 ? clamp(t * 100.0 / span, 0.0, 1.0) : 1.0;
+        float a = radians(s * mix(anim.z, anim.w, k));
+        v += vec3(-s * 0.25, 0.05, 0.0);
+        v = vec3(v.x * cos(a) - v.y * sin(a), v.x * sin(a) + v.y * cos(a), v.z);
+    }
+    // Every other tile is turned a quarter, as the board always drew them
+    if (anim.y < BRIDGE_LEFT && mod(floor(p.x * 2.0 + 0.5) + floor(p.z * 2.0 + 0.5), 2.0) == 1.0)
+        v.xz = vec2(v.z, -v.x);
+
+    fragColor = vertexColor * tileColor;
+    gl_Position = MVP * vec4(p + v, 1.0);
+}
@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+
+#include "alloc_track.h"
+
+static thread_local AllocCount total;
+static thread_local AllocScope *scope;
+static thread_local bool forbidden;
+
+void alloc_scope_begin(AllocScope *s,const char *name,bool allow)
+{
+  s->name=name;
+  s->outer=scope;
+  s->allow=allow||(scope!=NULL&&scope->allow);
+  scope=s;
+}
+
+void alloc_scope_end(AllocScope *s)
+{
+  scope=s->outer;
+}
+
+void alloc_forbid(bool on)
+{
+  forbidden=on;
+}
+
+void alloc_read(AllocCount *c)
+{
+  *c=total;
+}
+
+#ifdef BLOX_ALLOC_TRACK
+bool alloc_tracking()
+{
+  return true;
+}
+
+static void *counted(size_t size,bool nothrow)
+{
+  total.allocs++;
+  total.bytes+=size;
+  if(scope!=NULL)
+  {
+    scope->count.allocs++;
+    scope->count.bytes+=size;
+  }
+  if(forbidden&&(scope==NULL||!scope->allow))
+  {
+    forbidden=false;
+    fprintf(stderr,"Heap allocation of %zu bytes in %s while allocation is forbidden\n",size,
+            scope!=NULL ? scope->name : "no scope");
+    abort();
+  }
+  void *p=malloc(size>0 ? size : 1);
+  if(p==NULL&&!nothrow)
+    throw std::bad_alloc();
+  return p;
+}
+
+static void freed(void *p)
+{
+  if(p==NULL)
+    return;
+  total.frees++;
+  if(scope!=NULL)
+    scope->count.frees++;
+  free(p);
+}
+
+void *operator new(size_t size) { return counted(size,false); }
+void *operator new[](size_t size) { return counted(size,false); }
+void *operator new(size_t size,const std::nothrow_t &) noexcept { return counted(size,true); }
+void *operator new[](size_t size,const std::nothrow_t &) noexcept { return counted(size,true); }
+void operator delete(void *p) noexcept { freed(p); }
+void operator delete[](void *p) noexcept { freed(p); }
+void operator delete(void *p,size_t) noexcept { freed(p); }
+void operator delete[](void *p,size_t) noexcept { freed(p); }
+void operator delete(void *p,const std::nothrow_t &) noexcept { freed(p); }
+void operator delete[](void *p,const std::nothrow_t &) noexcept { freed(p); }
+#else
+bool alloc_tracking()
+{
+  return false;
+}
+#endif
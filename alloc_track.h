@@ -0,0 +1,40 @@
+#ifndef ALLOC_TRACK_H
+#define ALLOC_TRACK_H
+
+#include <stdint.h>
+
+/*
+ * Heap allocation tracking, opt in. Built with BLOX_ALLOC_TRACK the global
+ * operator new and delete count every allocation of the calling thread, in
+ * total and against its innermost open scope, so a frame or a subsystem can
+ * be checked for heap traffic. Otherwise the calls below cost nothing and
+ * count nothing.
+ */
+
+struct AllocCount {
+  uint64_t allocs,frees;
+  uint64_t bytes;               // asked for by the allocations
+};
+
+/* A subsystem. Counts add up over every time the scope is entered */
+struct AllocScope {
+  const char *name;
+  bool allow;                   // may allocate even while allocation is forbidden
+  AllocScope *outer;
+  AllocCount count;
+};
+
+/* Whether allocations are being counted at all */
+bool alloc_tracking();
+/* Everything this thread allocated so far */
+void alloc_read(AllocCount *c);
+void alloc_scope_begin(AllocScope *s,const char *name,bool allow);
+void alloc_scope_end(AllocScope *s);
+/*
+ * While forbidden, an allocation on this thread outside an allowing scope
+ * is reported with its size and scope and aborts, so a debugger stops right
+ * at the code that made it.
+ */
+void alloc_forbid(bool on);
+
+#endif
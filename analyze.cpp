@@ -0,0 +1,178 @@
+#include <limits.h>
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "analyze.h"
+
+using namespace std;
+
+#define WIN_EDGE 0xFFFFFFFEu
+#define NO_EDGE  0xFFFFFFFFu
+#define FAR      0xFFFFFFFFu
+
+const char *metric_name[NO_OF_METRICS]={"states","length","dead_ends","solutions","toggles"};
+
+/* How much each score counts towards the difficulty */
+static const double metric_weight[NO_OF_METRICS]={0.15,0.35,0.2,0.15,0.15};
+
+static void score_level(LevelMetrics *m)
+{
+  if(m->length<0)
+  {
+    for(int i=0;i<NO_OF_METRICS;i++)
+      m->score[i]=0;
+    m->difficulty=0;
+    return;
+  }
+  m->score[M_STATES]=min(1.0,log10((double)m->reachable)/6);
+  m->score[M_LENGTH]=min(1.0,m->length/100.0);
+  m->score[M_DEAD_ENDS]=m->dead_ends;
+  m->score[M_SOLUTIONS]=1/(1+log2((double)m->solutions));
+  m->score[M_TOGGLES]=min(1.0,m->toggles/4.0);
+  m->difficulty=0;
+  for(int i=0;i<NO_OF_METRICS;i++)
+    m->difficulty+=100*metric_weight[i]*m->score[i];
+}
+
+int analyze_level(const Level *lvl,AnalyzeWork *w,LevelMetrics *m)
+{
+  uint64_t count=sim_state_count(lvl);
+  if(w->stamp.size()<count)
+  {
+    w->stamp.assign(count,0);
+    w->order.resize(count);
+  }
+  if(++w->epoch==0)
+  {
+    w->stamp.assign(w->stamp.size(),0);
+    w->epoch=1;
+  }
+  w->reach.clear();
+  w->succ.clear();
+  w->fdist.clear();
+
+  // Forward BFS, keeping every roll
+  SimState s,t;
+  sim_reset(lvl,&s);
+  uint64_t start=sim_state_index(lvl,&s);
+  w->stamp[start]=w->epoch;
+  w->order[start]=0;
+  w->reach.push_back(start);
+  w->fdist.push_back(0);
+  for(size_t i=0;i<w->reach.size();i++)
+  {
+    sim_state_from_index(lvl,w->reach[i],&s);
+    for(int k=0;k<4;k++)
+    {
+      t=s;
+      int status=sim_step(lvl,&t,k);
+      uint32_t edge=NO_EDGE;
+      if(status==ST_WIN)
+        edge=WIN_EDGE;
+      else if(status==ST_OK)
+      {
+        uint64_t j=sim_state_index(lvl,&t);
+        if(w->stamp[j]!=w->epoch)
+        {
+          w->stamp[j]=w->epoch;
+          w->order[j]=w->reach.size();
+          w->reach.push_back(j);
+          w->fdist.push_back(w->fdist[i]+1);
+        }
+        edge=w->order[j];
+      }
+      w->succ.push_back(edge);
+    }
+  }
+  size_t n=w->reach.size();
+  m->reachable=n;
+
+  // Backward BFS over the reversed rolls gives the distance to the goal
+  w->first.assign(n+1,0);
+  for(size_t e=0;e<w->succ.size();e++)
+    if(w->succ[e]<n)
+      w->first[w->succ[e]+1]++;
+  for(size_t i=0;i<n;i++)
+    w->first[i+1]+=w->first[i];
+  w->pred.resize(w->first[n]);
+  w->queue.assign(w->first.begin(),w->first.end()-1);
+  for(size_t e=0;e<w->succ.size();e++)
+    if(w->succ[e]<n)
+      w->pred[w->queue[w->succ[e]]++]=e/4;
+  w->bdist.assign(n,FAR);
+  w->queue.clear();
+  for(size_t e=0;e<w->succ.size();e++)
+    if(w->succ[e]==WIN_EDGE&&w->bdist[e/4]==FAR)
+    {
+      w->bdist[e/4]=1;
+      w->queue.push_back(e/4);
+    }
+  for(size_t q=0;q<w->queue.size();q++)
+  {
+    uint32_t v=w->queue[q];
+    for(uint32_t k=w->first[v];k<w->first[v+1];k++)
+      if(w->bdist[w->pred[k]]==FAR)
+      {
+        w->bdist[w->pred[k]]=w->bdist[v]+1;
+        w->queue.push_back(w->pred[k]);
+      }
+  }
+  size_t dead=0;
+  for(size_t i=0;i<n;i++)
+    dead+=w->bdist[i]==FAR;
+  m->dead_ends=(double)dead/n;
+  m->length=w->bdist[0]==FAR ? -1 : (int)w->bdist[0];
+  m->solutions=0;
+  m->toggles=0;
+  if(m->length<0)
+  {
+    score_level(m);
+    return 0;
+  }
+
+  // Count shortest paths and the fewest toggles along them, in BFS order
+  uint64_t per_mask=(uint64_t)lvl->width*lvl->depth*3;
+  w->ways.assign(n,0);
+  w->toggles.assign(n,FAR);
+  w->ways[0]=1;
+  w->toggles[0]=0;
+  int best_toggles=INT_MAX;
+  for(size_t u=0;u<n;u++)
+  {
+    if(w->ways[u]==0||w->fdist[u]+w->bdist[u]!=(uint32_t)m->length)
+      continue;
+    for(int k=0;k<4;k++)
+    {
+      uint32_t v=w->succ[4*u+k];
+      if(v==WIN_EDGE)
+      {
+        m->solutions=w->ways[u]>UINT64_MAX-m->solutions ? UINT64_MAX : m->solutions+w->ways[u];
+        best_toggles=min(best_toggles,(int)w->toggles[u]);
+      }
+      if(v>=n||w->fdist[v]!=w->fdist[u]+1)
+        continue;
+      w->ways[v]=w->ways[u]>UINT64_MAX-w->ways[v] ? UINT64_MAX : w->ways[v]+w->ways[u];
+      uint32_t tg=w->toggles[u]+(w->reach[u]/per_mask!=w->reach[v]/per_mask);
+      w->toggles[v]=min(w->toggles[v],tg);
+    }
+  }
+  m->toggles=best_toggles;
+  score_level(m);
+  return 1;
+}
+
+void analyze_levels(const Level *const *levels,int n,int threads,LevelMetrics *out)
+{
+  atomic<int> next(0);
+  vector<thread> pool;
+  for(int t=0;t<max(1,threads);t++)
+    pool.push_back(thread([&]() {
+      AnalyzeWork work;
+      for(int i=next++;i<n;i=next++)
+        analyze_level(levels[i],&work,&out[i]);
+    }));
+  for(size_t t=0;t<pool.size();t++)
+    pool[t].join();
+}
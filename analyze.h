@@ -0,0 +1,42 @@
+#ifndef ANALYZE_H
+#define ANALYZE_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "sim.h"
+
+/*
+ * Difficulty metrics from the state space of a level. Every metric is also
+ * turned into a 0..1 score, harder is higher, and the weighted sum of the
+ * scores is the difficulty (0..100) used to order a pack.
+ */
+
+enum Metric { M_STATES, M_LENGTH, M_DEAD_ENDS, M_SOLUTIONS, M_TOGGLES, NO_OF_METRICS };
+extern const char *metric_name[NO_OF_METRICS];
+
+struct LevelMetrics {
+  uint64_t reachable;           // states reachable from the start
+  int length;                   // optimal solution, -1 if unsolvable
+  double dead_ends;             // fraction of reachable states that cannot win any more
+  uint64_t solutions;           // distinct optimal solutions, saturates at UINT64_MAX
+  int toggles;                  // fewest bridge toggles on an optimal solution
+  double score[NO_OF_METRICS];
+  double difficulty;
+};
+
+/* Scratch reused across levels by one thread */
+struct AnalyzeWork {
+  std::vector<uint32_t> stamp,order;    // state index -> position in reach
+  uint32_t epoch;
+  std::vector<uint64_t> reach;
+  std::vector<uint32_t> succ,first,pred,queue;
+  std::vector<uint32_t> fdist,bdist,toggles;
+  std::vector<uint64_t> ways;
+  AnalyzeWork() : epoch(0) {}
+};
+
+int analyze_level(const Level *lvl,AnalyzeWork *work,LevelMetrics *m);
+void analyze_levels(const Level *const *levels,int n,int threads,LevelMetrics *out);
+
+#endif
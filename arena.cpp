@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#include "arena.h"
+
+#if defined(__SANITIZE_ADDRESS__)
+#define ARENA_ASAN 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define ARENA_ASAN 1
+#endif
+#endif
+#ifdef ARENA_ASAN
+#include <sanitizer/asan_interface.h>
+#define POISON(p,n) ASAN_POISON_MEMORY_REGION(p,n)
+#define UNPOISON(p,n) ASAN_UNPOISON_MEMORY_REGION(p,n)
+#else
+#define POISON(p,n) ((void)(p),(void)(n))
+#define UNPOISON(p,n) ((void)(p),(void)(n))
+#endif
+
+using namespace std;
+
+#define ARENA_ALIGN 16
+#define ARENA_MIN_BLOCK (64*1024)
+
+struct ArenaBlock {
+  ArenaBlock *next;
+  size_t size;
+  size_t pad;                   // keeps data 16 byte aligned
+  size_t used;                  // of an older block, as it was left
+};
+
+static inline uint8_t *data(ArenaBlock *b)
+{
+  return (uint8_t *)(b+1);
+}
+
+static ArenaBlock *new_block(size_t size,ArenaBlock *next)
+{
+  ArenaBlock *b=(ArenaBlock *)malloc(sizeof(ArenaBlock)+size);
+  if(b==NULL)
+  {
+    fprintf(stderr,"Out of memory for an arena block of %zu bytes\n",size);
+    abort();
+  }
+  b->next=next;
+  b->size=size;
+  b->used=0;
+  POISON(data(b),size);
+  return b;
+}
+
+void arena_init(Arena *a,const char *name,size_t size)
+{
+  memset(a,0,sizeof(*a));
+  a->name=name;
+  if(size>0)
+  {
+    a->block=new_block(size,NULL);
+    a->capacity=size;
+  }
+}
+
+void *arena_alloc(Arena *a,size_t size)
+{
+  size=(size+ARENA_ALIGN-1)&~(size_t)(ARENA_ALIGN-1);
+  if(a->block==NULL||a->used+size>a->block->size)
+  {
+    // Chain a block; the next reset folds it into one big enough
+    if(a->block!=NULL)
+    {
+      a->block->used=a->used;
+      a->overflows++;
+    }
+    size_t n=max(max(size,(size_t)ARENA_MIN_BLOCK),a->capacity);
+    a->block=new_block(n,a->block);
+    a->capacity+=n;
+    a->used=0;
+  }
+  uint8_t *p=data(a->block)+a->used;
+  a->used+=size;
+  a->live+=size;
+  a->high_water=max(a->high_water,a->live);
+  UNPOISON(p,size);
+#ifdef BLOX_ARENA_DEBUG
+  memset(p,0xCD,size);
+#endif
+  return p;
+}
+
+void arena_reset(Arena *a)
+{
+  if(a->block==NULL)
+    return;
+  a->block->used=a->used;
+#ifdef BLOX_ARENA_DEBUG
+  for(ArenaBlock *b=a->block;b!=NULL;b=b->next)
+    memset(data(b),0xDD,b->used);
+#endif
+  if(a->block->next!=NULL)
+  {
+    size_t size=a->capacity;
+    arena_free(a);
+    a->block=new_block(size,NULL);
+    a->capacity=size;
+  }
+  else
+    POISON(data(a->block),a->block->size);
+  a->block->used=0;
+  a->used=0;
+  a->live=0;
+  a->resets++;
+}
+
+void arena_free(Arena *a)
+{
+  while(a->block!=NULL)
+  {
+    ArenaBlock *next=a->block->next;
+    UNPOISON(data(a->block),a->block->size);
+    free(a->block);
+    a->block=next;
+  }
+  a->used=a->live=a->capacity=0;
+}
+
+void arena_report(const Arena *a)
+{
+  fprintf(stderr,"arena %s: high water %zu of %zu bytes, %llu resets, %llu overflows\n",
+          a->name!=NULL ? a->name : "?",a->high_water,a->capacity,(unsigned long long)a->resets,
+          (unsigned long long)a->overflows);
+}
@@ -0,0 +1,46 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Bump pointer arenas for data that dies all at once: the frame's scratch,
+ * reset at the top of every frame, and a level's, reset when its slot gets
+ * another level. An allocation is an add; nothing is freed on its own.
+ *
+ * An arena that runs out chains another block, and the next reset merges
+ * the blocks into one as big as the most ever used, so after a few resets
+ * an arena stops calling malloc. A zeroed Arena is ready to use.
+ *
+ * Built with BLOX_ARENA_DEBUG, new memory is filled with 0xCD and reset
+ * memory with 0xDD, so reads of uninitialized or stale data stand out; under
+ * AddressSanitizer the unused part of a block is poisoned too.
+ */
+
+struct ArenaBlock;
+
+struct Arena {
+  const char *name;
+  ArenaBlock *block;            // the one allocated from, then older ones
+  size_t used;                  // bytes of block in use
+  size_t live;                  // bytes handed out since the reset
+  size_t high_water;            // most live bytes ever
+  size_t capacity;              // bytes of all blocks
+  uint64_t resets,overflows;
+};
+
+void arena_init(Arena *a,const char *name,size_t size);
+/* 16 byte aligned, never NULL */
+void *arena_alloc(Arena *a,size_t size);
+void arena_reset(Arena *a);
+void arena_free(Arena *a);
+/* One line to stderr: high water mark, capacity, resets and overflows */
+void arena_report(const Arena *a);
+
+template<class T> T *arena_array(Arena *a,size_t n)
+{
+  return (T *)arena_alloc(a,n*sizeof(T));
+}
+
+#endif
@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+#include "bench.h"
+
+using namespace std;
+
+void bench_init(BenchSuite *s)
+{
+  s->warmup=5;
+  s->reps=200;
+  s->rep_seconds=0.002;
+  s->filter=NULL;
+  s->renderer.clear();
+  s->counters.leader=-1;
+  s->counters.open=0;
+  for(int i=0;i<CTR_COUNT;i++)
+    s->counters.fd[i]=s->counters.slot[i]=-1;
+  s->results.clear();
+}
+
+int bench_counters(BenchSuite *s)
+{
+  if(counters_open(&s->counters)==0)
+    fprintf(stderr,"No hardware counters (%s), timing only\n",s->counters.error);
+  return s->counters.open;
+}
+
+static double time_batch(BenchBody body,void *arg,uint64_t iters)
+{
+  chrono::steady_clock::time_point t0=chrono::steady_clock::now();
+  for(uint64_t i=0;i<iters;i++)
+    body(arg);
+  return chrono::duration<double>(chrono::steady_clock::now()-t0).count();
+}
+
+void bench_run(BenchSuite *s,const char *name,BenchBody body,void *arg,uint64_t elements)
+{
+  if(s->filter!=NULL&&strstr(name,s->filter)==NULL)
+    return;
+  // Grow the batch until it is long enough to size it from
+  uint64_t iters=1;
+  double t=time_batch(body,arg,iters);
+  while(t<s->rep_seconds/10&&iters<((uint64_t)1<<40))
+  {
+    iters*=2;
+    t=time_batch(body,arg,iters);
+  }
+  iters=max<uint64_t>(1,iters*s->rep_seconds/max(t,1e-9));
+
+  vector<double> per_call;
+  double total[CTR_COUNT]={0},value[CTR_COUNT];
+  uint64_t counted=0;
+  for(int r=0;r<s->warmup+s->reps;r++)
+  {
+    counters_start(&s->counters);
+    t=time_batch(body,arg,iters);
+    int ok=counters_stop(&s->counters,value);
+    if(r<s->warmup)
+      continue;
+    per_call.push_back(t/iters*1e9);
+    if(ok)
+    {
+      for(int i=0;i<CTR_COUNT;i++)
+        total[i]+=value[i];
+      counted+=iters;
+    }
+  }
+  sort(per_call.begin(),per_call.end());
+  BenchResult b;
+  b.name=name;
+  b.reps=per_call.size();
+  b.iters=iters;
+  b.elements=max<uint64_t>(elements,1);
+  b.median_ns=per_call[per_call.size()/2];
+  b.p99_ns=per_call[min(per_call.size()-1,per_call.size()*99/100)];
+  b.min_ns=per_call[0];
+  b.mean_ns=0;
+  for(size_t i=0;i<per_call.size();i++)
+    b.mean_ns+=per_call[i]/per_call.size();
+  for(int i=0;i<CTR_COUNT;i++)
+    b.counter[i]=counted>0&&s->counters.slot[i]>=0 ? total[i]/counted : -1;
+  s->results.push_back(b);
+  fprintf(stderr,"%-32s median %12.1f ns  p99 %12.1f ns  (%d x %llu calls)\n",name,b.median_ns,
+          b.p99_ns,b.reps,(unsigned long long)b.iters);
+  if(counted>0)
+  {
+    fprintf(stderr,"%32s",b.elements>1 ? "per element" : "per call");
+    for(int i=0;i<CTR_COUNT;i++)
+      if(b.counter[i]>=0)
+        fprintf(stderr,"  %s %.2f",counter_name[i],b.counter[i]/b.elements);
+    fprintf(stderr,"\n");
+  }
+}
+
+static void json_string(FILE *f,const string &s)
+{
+  fputc('"',f);
+  for(size_t i=0;i<s.size();i++)
+  {
+    if(s[i]=='"'||s[i]=='\\')
+      fputc('\\',f);
+    if((unsigned char)s[i]>=0x20)
+      fputc(s[i],f);
+  }
+  fputc('"',f);
+}
+
+int bench_write_json(const BenchSuite *s,const char *path)
+{
+  FILE *f=strcmp(path,"-")==0 ? stdout : fopen(path,"w");
+  if(f==NULL)
+    return 0;
+  fprintf(f,"{\n  \"warmup\": %d,\n  \"reps\": %d,\n  \"rep_seconds\": %g,\n  \"renderer\": ",
+          s->warmup,s->reps,s->rep_seconds);
+  json_string(f,s->renderer);
+  fprintf(f,",\n  \"counters\": [");
+  for(int i=0,n=0;i<CTR_COUNT;i++)
+    if(s->counters.slot[i]>=0)
+      fprintf(f,"%s\"%s\"",n++>0 ? ", " : "",counter_name[i]);
+  fprintf(f,"],\n  \"benchmarks\": [");
+  for(size_t i=0;i<s->results.size();i++)
+  {
+    const BenchResult *b=&s->results[i];
+    fprintf(f,"%s\n    {\"name\": ",i>0 ? "," : "");
+    json_string(f,b->name);
+    fprintf(f,", \"reps\": %d, \"iters\": %llu, \"elements\": %llu, \"median_ns\": %.1f, \"p99_ns\": %.1f, "
+            "\"min_ns\": %.1f, \"mean_ns\": %.1f",b->reps,(unsigned long long)b->iters,
+            (unsigned long long)b->elements,b->median_ns,b->p99_ns,b->min_ns,b->mean_ns);
+    // Counters per call and per element, only those that counted
+    for(int per=0;per<2;per++)
+    {
+      int n=0;
+      for(int k=0;k<CTR_COUNT;k++)
+        if(b->counter[k]>=0)
+          fprintf(f,"%s\"%s\": %.3f",n++>0 ? ", " : per ? ", \"per_element\": {" : ", \"per_call\": {",
+                  counter_name[k],b->counter[k]/(per ? b->elements : 1));
+      if(n>0)
+        fprintf(f,"}");
+    }
+    fprintf(f,"}");
+  }
+  fprintf(f,"\n  ]\n}\n");
+  return f==stdout ? fflush(f)==0 : fclose(f)==0;
+}
@@ -0,0 +1,69 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "counters.h"
+
+/*
+ * Micro-benchmarks. A body is called in batches sized so one repetition
+ * takes about rep_seconds, the first warmup repetitions are thrown away and
+ * the time per call of the others gives the median and p99. Results are
+ * written as JSON so runs before and after a change can be diffed.
+ */
+
+typedef void (*BenchBody)(void *arg);
+
+struct BenchResult {
+  std::string name;
+  int reps;
+  uint64_t iters;               // calls per repetition
+  uint64_t elements;            // tiles, states, vertices... a call works on
+  double median_ns,p99_ns,min_ns,mean_ns;
+  double counter[CTR_COUNT];    // per call over the measured repetitions, -1 if not counted
+};
+
+struct BenchSuite {
+  int warmup,reps;
+  double rep_seconds;
+  const char *filter;           // only names containing it, NULL for all
+  std::string renderer;         // GL_RENDERER of the GL benchmarks, empty without GL
+  Counters counters;            // none open unless bench_counters found some
+  std::vector<BenchResult> results;
+};
+
+void bench_init(BenchSuite *s);
+/* Count cycles, cache misses and so on around every repetition from now on.
+   Returns the number of counters that opened, 0 leaves timing alone */
+int bench_counters(BenchSuite *s);
+void bench_run(BenchSuite *s,const char *name,BenchBody body,void *arg,uint64_t elements);
+int bench_write_json(const BenchSuite *s,const char *path);
+
+/* The game's own benchmarks, in Sample_GL3_2D.cpp built with BLOX_BENCH.
+   The GL ones need a current 3.3 core context and are skipped without gl */
+void game_bench(BenchSuite *s,bool gl);
+
+/* One board of blox_bench -scale, a row of the CSV */
+#define SCALE_VIEWS 6
+struct ScaleRow {
+  int size;                     // the board is size x size cells
+  double density;
+  int tiles;
+  double gen_ms;                // generating the board
+  double load_ms;               // mapping its .blv and laying out its tiles
+  uint64_t store_bytes;         // the TileStore they are laid out in
+  double upload_ms;             // instance and animation buffers, to glFinish
+  uint64_t gpu_bytes;           // size of those buffers
+  double frame_ms[SCALE_VIEWS]; // median draw+glFinish in each camera mode
+  double solve_ms;
+  uint64_t solver_bytes;        // SolverWork after the solve
+  uint64_t reachable;
+};
+extern const char *const scale_view_name[SCALE_VIEWS];
+/* Load the level file at path on the game's board and time a frame in each
+   camera mode. The board need not fit 14x14: nothing but drawing is done */
+int game_scale(BenchSuite *s,const char *path,ScaleRow *row);
+
+#endif
@@ -0,0 +1,271 @@
+/* Micro-benchmarks of the game and the solver, run by make bench */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+#ifdef __APPLE__
+#include <GLFW/glfw3.h>
+#else
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include "bench.h"
+#include "generator.h"
+#include "level_file.h"
+#include "sim.h"
+#include "solver.h"
+#include "tile_store.h"
+
+using namespace std;
+
+static void usage()
+{
+  fprintf(stderr,"usage: blox_bench [-out FILE.json] [-reps N] [-warmup N] [-ms MS] [-filter NAME] [-nogl] [-counters]\n"
+                 "       blox_bench -scale FILE.csv [-maxsize N] [-density D,D...] [-reps N] [-nogl] [-counters]\n");
+  exit(EXIT_FAILURE);
+}
+
+/*
+ * A headless 3.3 core context. On Linux it is Mesa's llvmpipe through a
+ * surfaceless EGL display, so numbers do not depend on a GPU or a desktop;
+ * the Mac has no EGL and gets a hidden GLFW window.
+ */
+static bool gl_context()
+{
+#ifdef __APPLE__
+  if(!glfwInit())
+    return false;
+  glfwWindowHint(GLFW_VISIBLE,GLFW_FALSE);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR,3);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR,3);
+  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT,GL_TRUE);
+  glfwWindowHint(GLFW_OPENGL_PROFILE,GLFW_OPENGL_CORE_PROFILE);
+  GLFWwindow *w=glfwCreateWindow(16,16,"bench",NULL,NULL);
+  if(w==NULL)
+    return false;
+  glfwMakeContextCurrent(w);
+  return gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+#else
+  setenv("LIBGL_ALWAYS_SOFTWARE","1",0);
+  PFNEGLGETPLATFORMDISPLAYEXTPROC get_display=
+    (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+  EGLDisplay d=get_display!=NULL ? get_display(EGL_PLATFORM_SURFACELESS_MESA,EGL_DEFAULT_DISPLAY,NULL)
+                                 : eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  if(d==EGL_NO_DISPLAY||!eglInitialize(d,NULL,NULL)||!eglBindAPI(EGL_OPENGL_API))
+    return false;
+  static const EGLint config_attr[]={EGL_SURFACE_TYPE,EGL_PBUFFER_BIT,EGL_RENDERABLE_TYPE,EGL_OPENGL_BIT,EGL_NONE};
+  static const EGLint context_attr[]={EGL_CONTEXT_MAJOR_VERSION,3,EGL_CONTEXT_MINOR_VERSION,3,
+                                      EGL_CONTEXT_OPENGL_PROFILE_MASK,EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                                      EGL_NONE};
+  EGLConfig config;
+  EGLint n=0;
+  if(!eglChooseConfig(d,config_attr,&config,1,&n)||n<1)
+    return false;
+  EGLContext c=eglCreateContext(d,config,EGL_NO_CONTEXT,context_attr);
+  if(c==EGL_NO_CONTEXT||!eglMakeCurrent(d,EGL_NO_SURFACE,EGL_NO_SURFACE,c))
+    return false;
+  return gladLoadGLLoader((GLADloadproc)eglGetProcAddress);
+#endif
+}
+
+struct SolveArg {
+  Level lvl;
+  SolverWork work;
+  SolveResult result;
+};
+
+static void bench_solve(void *arg)
+{
+  SolveArg *a=(SolveArg *)arg;
+  solve_level(&a->lvl,&a->work,&a->result);
+}
+
+struct StoreArg {
+  OwnedLevel o;
+  Arena arena;
+  TileStore tiles;
+};
+
+static void bench_store(void *arg)
+{
+  StoreArg *a=(StoreArg *)arg;
+  arena_reset(&a->arena);
+  tile_store_build(&a->tiles,&a->o.lvl,&a->arena);
+}
+
+/*
+ * Boards from 14x14 to 4096x4096 at a few tile densities, one CSV row each.
+ * The per tile columns stay flat while a cost grows linearly, so anything
+ * superlinear shows up as a rising curve.
+ */
+static const int scale_size[]={14,32,64,128,256,512,1024,2048,4096};
+
+static int scale(BenchSuite *s,const char *out,int max_size,const vector<double> &density,bool gl)
+{
+  FILE *f=fopen(out,"w");
+  if(f==NULL)
+    return 0;
+  fprintf(f,"size,density,tiles,gen_ms,load_ms,store_bytes,upload_ms,gpu_bytes");
+  for(int v=0;v<SCALE_VIEWS;v++)
+    fprintf(f,",frame_ms_%s",scale_view_name[v]);
+  fprintf(f,",solve_ms,solver_bytes,reachable,load_ns_per_tile,store_bytes_per_tile,upload_ns_per_tile,"
+          "gpu_bytes_per_tile,solve_ns_per_tile,solver_bytes_per_tile\n");
+  string blv=string(out)+".blv";
+  for(size_t i=0;i<sizeof(scale_size)/sizeof(scale_size[0])&&scale_size[i]<=max_size;i++)
+    for(size_t j=0;j<density.size();j++)
+    {
+      ScaleRow row;
+      memset(&row,0,sizeof(row));
+      row.size=scale_size[i];
+      row.density=density[j];
+      GenParams p;
+      gen_default_params(&p);
+      p.width=p.depth=row.size;
+      p.density=row.density;
+      p.bridges=0;
+      OwnedLevel o;
+      owned_level_alloc(&o,row.size,row.size);
+      chrono::steady_clock::time_point t0=chrono::steady_clock::now();
+      uint64_t index=0;
+      while(!generate_candidate(&p,index,&o)&&index<100)
+        index++;
+      row.gen_ms=chrono::duration<double,milli>(chrono::steady_clock::now()-t0).count();
+      row.tiles=o.lvl.no_of_tiles;
+      {
+        SolverWork work;
+        SolveResult result;
+        t0=chrono::steady_clock::now();
+        solve_level(&o.lvl,&work,&result);
+        row.solve_ms=chrono::duration<double,milli>(chrono::steady_clock::now()-t0).count();
+        row.solver_bytes=work.stamp.capacity()*sizeof(uint32_t)+work.parent.capacity()*sizeof(uint32_t)+
+                         work.queue.capacity()*sizeof(uint64_t);
+        row.reachable=result.reachable;
+      }
+      if(gl&&!(level_file_write(blv.c_str(),&o.lvl)&&game_scale(s,blv.c_str(),&row)))
+        fprintf(stderr,"Could not load the %dx%d board through %s\n",row.size,row.size,blv.c_str());
+      unlink(blv.c_str());
+      owned_level_free(&o);
+
+      double t=row.tiles>0 ? row.tiles : 1;
+      fprintf(f,"%d,%g,%d,%.3f,%.3f,%llu,%.3f,%llu",row.size,row.density,row.tiles,row.gen_ms,row.load_ms,
+              (unsigned long long)row.store_bytes,row.upload_ms,(unsigned long long)row.gpu_bytes);
+      for(int v=0;v<SCALE_VIEWS;v++)
+        fprintf(f,",%.3f",row.frame_ms[v]);
+      fprintf(f,",%.3f,%llu,%llu,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f\n",row.solve_ms,(unsigned long long)row.solver_bytes,
+              (unsigned long long)row.reachable,row.load_ms*1e6/t,row.store_bytes/t,row.upload_ms*1e6/t,
+              row.gpu_bytes/t,row.solve_ms*1e6/t,row.solver_bytes/t);
+      fflush(f);
+      fprintf(stderr,"%dx%d density %g: %d tiles, solve %.1f ms, frame %.3f ms\n",row.size,row.size,
+              row.density,row.tiles,row.solve_ms,row.frame_ms[0]);
+    }
+  return fclose(f)==0;
+}
+
+int main(int argc,char **argv)
+{
+  BenchSuite suite;
+  const char *out="bench.json",*scale_out=NULL;
+  int max_size=4096,reps=0,warmup=-1;
+  double ms=0;
+  vector<double> density;
+  bool gl=true,counters=false;
+  bench_init(&suite);
+  for(int i=1;i<argc;i++)
+  {
+    if(!strcmp(argv[i],"-out")&&i+1<argc) out=argv[++i];
+    else if(!strcmp(argv[i],"-reps")&&i+1<argc) reps=atoi(argv[++i]);
+    else if(!strcmp(argv[i],"-warmup")&&i+1<argc) warmup=atoi(argv[++i]);
+    else if(!strcmp(argv[i],"-ms")&&i+1<argc) ms=atof(argv[++i]);
+    else if(!strcmp(argv[i],"-filter")&&i+1<argc) suite.filter=argv[++i];
+    else if(!strcmp(argv[i],"-nogl")) gl=false;
+    else if(!strcmp(argv[i],"-counters")) counters=true;
+    else if(!strcmp(argv[i],"-scale")&&i+1<argc) scale_out=argv[++i];
+    else if(!strcmp(argv[i],"-maxsize")&&i+1<argc) max_size=atoi(argv[++i]);
+    else if(!strcmp(argv[i],"-density")&&i+1<argc)
+    {
+      for(char *p=argv[++i],*end;*p!=0;p=*end==',' ? end+1 : end)
+      {
+        density.push_back(strtod(p,&end));
+        if(end==p||density.back()<=0||density.back()>1)
+          usage();
+      }
+    }
+    else usage();
+  }
+  if(scale_out!=NULL)
+  {
+    // A frame of a big board takes seconds on llvmpipe, so a few of them
+    suite.reps=3;
+    suite.warmup=1;
+    suite.rep_seconds=1e-6;
+  }
+  if(reps!=0) suite.reps=reps;
+  if(warmup>=0) suite.warmup=warmup;
+  if(ms!=0) suite.rep_seconds=ms/1000;
+  if(suite.reps<1||suite.rep_seconds<=0||max_size<14)
+    usage();
+
+  if(counters)
+    bench_counters(&suite);
+  if(gl&&!gl_context())
+  {
+    fprintf(stderr,"No OpenGL 3.3 context, the GL benchmarks are skipped\n");
+    gl=false;
+  }
+  if(scale_out!=NULL)
+  {
+    if(density.empty())
+    {
+      density.push_back(0.25);
+      density.push_back(1);
+    }
+    if(!scale(&suite,scale_out,max_size,density,gl))
+    {
+      fprintf(stderr,"Could not write %s\n",scale_out);
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
+
+  for(int level=1;level<=3;level++)
+  {
+    char name[32];
+    SolveArg *a=new SolveArg;
+    builtin_level(level,&a->lvl);
+    snprintf(name,sizeof(name),"solve_level %d",level);
+    // Per element is per reachable state
+    solve_level(&a->lvl,&a->work,&a->result);
+    bench_run(&suite,name,bench_solve,a,a->result.reachable);
+    delete a;
+  }
+  {
+    // Laying out a million tiles, per element is per tile
+    StoreArg *a=new StoreArg;
+    GenParams p;
+    gen_default_params(&p);
+    p.width=p.depth=1024;
+    p.density=1;
+    p.bridges=0;
+    owned_level_alloc(&a->o,p.width,p.depth);
+    memset(&a->arena,0,sizeof(a->arena));
+    for(uint64_t index=0;!generate_candidate(&p,index,&a->o)&&index<100;index++)
+      ;
+    bench_run(&suite,"tile_store_build 1024x1024",bench_store,a,a->o.lvl.no_of_tiles);
+    arena_free(&a->arena);
+    owned_level_free(&a->o);
+    delete a;
+  }
+  game_bench(&suite,gl);
+  if(!bench_write_json(&suite,out))
+  {
+    fprintf(stderr,"Could not write %s\n",out);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,610 @@
+/* Headless tools over the simulation core. Run without arguments for usage */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <thread>
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+#include "sim.h"
+#include "hint.h"
+#include "extbfs.h"
+#include "generator.h"
+#include "level_text.h"
+#include "analyze.h"
+#include "level_file.h"
+#include "level_pack.h"
+#include "replay_run.h"
+#include "env.h"
+#include "raster.h"
+#include "obs_ring.h"
+
+static void usage()
+{
+  fprintf(stderr,
+    "usage: blox_tool hints LEVEL OUT.hint\n"
+    "       blox_tool extbfs LEVEL [-dir DIR] [-mem MB]\n"
+    "       blox_tool generate [-size W D] [-count N] [-seed S] [-threads T] [-len MIN MAX]\n"
+    "                          [-branch B] [-bridges K] [-fragile F] [-density D] [-out DIR]\n"
+    "       blox_tool analyze [-threads T] [-generate N] [-seed S] [LEVEL...]\n"
+    "       blox_tool export LEVEL OUT.blv|OUT.txt\n"
+    "       blox_tool pack OUT.bxp [-hints] LEVEL...\n"
+    "       blox_tool info LEVEL\n"
+    "       blox_tool replay [-threads T] [-pack PACK.bxp] [-share NAME] FILE.bxr...\n"
+    "       blox_tool env [-threads T] [-envs N] [-steps S] [-limit L] [-render] LEVEL\n"
+    "       blox_tool watch NAME [-seconds S]\n"
+    "LEVEL is the number of a built-in level, a .blv or a .txt file, or PACK.bxp:N\n");
+  exit(EXIT_FAILURE);
+}
+
+static bool has_suffix(const char *s,const char *suffix)
+{
+  size_t n=strlen(s),k=strlen(suffix);
+  return n>=k&&!strcmp(s+n-k,suffix);
+}
+
+/* Mapped files stay mapped until the tool exits */
+static void load_level(const char *arg,Level *lvl)
+{
+  const char *colon=strrchr(arg,':');
+  if(colon!=NULL&&colon-arg>4&&!strncmp(colon-4,".bxp",4))
+  {
+    std::string path(arg,colon-arg);
+    LevelPack pack;
+    if(level_pack_open(path.c_str(),&pack)&&level_pack_level(&pack,atoi(colon+1),lvl))
+      return;
+  }
+  else if(has_suffix(arg,".blv"))
+  {
+    MappedLevel m;
+    if(level_file_map(arg,&m))
+    {
+      *lvl=m.lvl;
+      return;
+    }
+  }
+  else if(has_suffix(arg,".txt"))
+  {
+    // One cell per character, so the file size bounds the board
+    struct stat st;
+    if(stat(arg,&st)==0)
+    {
+      LevelParse *p=new LevelParse;
+      p->capacity=st.st_size;
+      p->tile=new uint8_t[p->capacity];
+      p->order=new int16_t[2*p->capacity];
+      if(level_read_text(arg,p,lvl))
+        return;
+      fprintf(stderr,"%s: %s\n",arg,p->error);
+      exit(EXIT_FAILURE);
+    }
+  }
+  else if(builtin_level(atoi(arg),lvl))
+    return;
+  {
+    fprintf(stderr,"No level %s\n",arg);
+    exit(EXIT_FAILURE);
+  }
+}
+
+static int cmd_hints(int argc,char **argv)
+{
+  Level lvl;
+  HintTable table;
+  if(argc!=2)
+    usage();
+  load_level(argv[0],&lvl);
+  hint_table_build(&lvl,&table);
+  SimState s;
+  sim_reset(&lvl,&s);
+  printf("%llu states, %d rolls from the start\n",(unsigned long long)table.count,
+         hint_distance(&table,sim_state_index(&lvl,&s)));
+  int ok=hint_table_save(&table,argv[1]);
+  if(!ok)
+    fprintf(stderr,"Could not write %s\n",argv[1]);
+  hint_table_free(&table);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static int cmd_extbfs(int argc,char **argv)
+{
+  Level lvl;
+  const char *dir=".";
+  size_t mem=256;
+  if(argc<1)
+    usage();
+  load_level(argv[0],&lvl);
+  for(int i=1;i<argc;i++)
+  {
+    if(!strcmp(argv[i],"-dir")&&i+1<argc) dir=argv[++i];
+    else if(!strcmp(argv[i],"-mem")&&i+1<argc) mem=atol(argv[++i]);
+    else usage();
+  }
+  ExtBfsStats st;
+  if(!ext_bfs(&lvl,dir,mem<<20,&st))
+  {
+    fprintf(stderr,"External BFS failed in %s\n",dir);
+    return EXIT_FAILURE;
+  }
+  printf("states      %llu\n",(unsigned long long)st.states);
+  printf("layers      %d\n",st.layers);
+  printf("goal depth  %d\n",st.goal_depth);
+  printf("time        %.3f s\n",st.seconds);
+  printf("states/s    %.0f\n",st.states/st.seconds);
+  printf("read        %llu bytes (%.1f MB/s)\n",(unsigned long long)st.bytes_read,st.bytes_read/st.seconds/1e6);
+  printf("written     %llu bytes (%.1f MB/s)\n",(unsigned long long)st.bytes_written,st.bytes_written/st.seconds/1e6);
+  return EXIT_SUCCESS;
+}
+
+static int cmd_generate(int argc,char **argv)
+{
+  GenParams p;
+  const char *dir=NULL;
+  gen_default_params(&p);
+  for(int i=0;i<argc;i++)
+  {
+    if(!strcmp(argv[i],"-size")&&i+2<argc) {p.width=atoi(argv[++i]);p.depth=atoi(argv[++i]);}
+    else if(!strcmp(argv[i],"-count")&&i+1<argc) p.count=atoi(argv[++i]);
+    else if(!strcmp(argv[i],"-seed")&&i+1<argc) p.seed=strtoull(argv[++i],NULL,10);
+    else if(!strcmp(argv[i],"-threads")&&i+1<argc) p.threads=atoi(argv[++i]);
+    else if(!strcmp(argv[i],"-len")&&i+2<argc) {p.min_length=atoi(argv[++i]);p.max_length=atoi(argv[++i]);}
+    else if(!strcmp(argv[i],"-branch")&&i+1<argc) p.min_branching=atof(argv[++i]);
+    else if(!strcmp(argv[i],"-bridges")&&i+1<argc) p.bridges=atoi(argv[++i]);
+    else if(!strcmp(argv[i],"-fragile")&&i+1<argc) p.fragile=atof(argv[++i]);
+    else if(!strcmp(argv[i],"-density")&&i+1<argc) p.density=atof(argv[++i]);
+    else if(!strcmp(argv[i],"-out")&&i+1<argc) dir=argv[++i];
+    else usage();
+  }
+  if(p.width<2||p.depth<2||p.width>4096||p.depth>4096)
+  {
+    fprintf(stderr,"Board size must be between 2 and 4096\n");
+    return EXIT_FAILURE;
+  }
+  std::vector<GenLevel*> levels;
+  GenStats st;
+  int n=generate_levels(&p,&levels,&st);
+  for(int i=0;i<n;i++)
+  {
+    GenLevel *g=levels[i];
+    if(dir!=NULL)
+    {
+      char path[1024];
+      snprintf(path,sizeof(path),"%s/gen%05d.txt",dir,i);
+      FILE *f=fopen(path,"w");
+      if(f==NULL)
+      {
+        fprintf(stderr,"Could not write %s\n",path);
+        return EXIT_FAILURE;
+      }
+      fprintf(f,"# candidate %llu, %d rolls: %s\n",(unsigned long long)g->index,g->result.length,g->result.moves);
+      level_write_text(f,&g->level.lvl);
+      fclose(f);
+    }
+    owned_level_free(&g->level);
+    delete g;
+  }
+  printf("kept %d of %llu candidates in %.3f s (%.0f levels/min)\n",n,(unsigned long long)st.tried,
+         st.seconds,n/st.seconds*60);
+  return n==p.count ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static int cmd_export(int argc,char **argv)
+{
+  Level lvl;
+  if(argc!=2)
+    usage();
+  load_level(argv[0],&lvl);
+  int ok;
+  if(has_suffix(argv[1],".txt"))
+  {
+    FILE *f=fopen(argv[1],"w");
+    ok=f!=NULL;
+    if(ok)
+    {
+      level_write_text(f,&lvl);
+      ok=fclose(f)==0;
+    }
+  }
+  else
+    ok=level_file_write(argv[1],&lvl);
+  if(!ok)
+    fprintf(stderr,"Could not write %s\n",argv[1]);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static int cmd_pack(int argc,char **argv)
+{
+  std::vector<Level> levels;
+  std::vector<const char*> names;
+  bool hints=false;
+  if(argc<2)
+    usage();
+  for(int i=1;i<argc;i++)
+  {
+    if(!strcmp(argv[i],"-hints")) hints=true;
+    else if(argv[i][0]=='-') usage();
+    else
+    {
+      Level lvl;
+      load_level(argv[i],&lvl);
+      levels.push_back(lvl);
+      const char *base=strrchr(argv[i],'/');
+      names.push_back(base!=NULL ? base+1 : argv[i]);
+    }
+  }
+  int n=levels.size();
+  if(n==0)
+    usage();
+  std::vector<const Level*> ptr(n);
+  for(int i=0;i<n;i++)
+    ptr[i]=&levels[i];
+  if(!level_pack_write(argv[0],&ptr[0],&names[0],n,hints))
+  {
+    fprintf(stderr,"Could not write %s\n",argv[0]);
+    return EXIT_FAILURE;
+  }
+  LevelPack pack;
+  if(!level_pack_open(argv[0],&pack))
+  {
+    fprintf(stderr,"%s does not read back\n",argv[0]);
+    return EXIT_FAILURE;
+  }
+  for(int i=0;i<pack.count;i++)
+    printf("%4d %-24s %08x %8u bytes %10llu hint bytes\n",i+1,pack.toc[i].name,pack.toc[i].level_hash,
+           pack.toc[i].level_size,(unsigned long long)pack.toc[i].hint_size);
+  printf("%d levels, %llu bytes\n",pack.count,(unsigned long long)pack.size);
+  level_pack_close(&pack);
+  return EXIT_SUCCESS;
+}
+
+static int cmd_info(int argc,char **argv)
+{
+  Level lvl;
+  if(argc!=1)
+    usage();
+  std::chrono::steady_clock::time_point t0=std::chrono::steady_clock::now();
+  load_level(argv[0],&lvl);
+  double us=std::chrono::duration<double,std::micro>(std::chrono::steady_clock::now()-t0).count();
+  printf("size        %d x %d\n",lvl.width,lvl.depth);
+  printf("tiles       %d\n",lvl.no_of_tiles);
+  printf("start       %d %d\n",lvl.start_x,lvl.start_z);
+  printf("goal        %d %d\n",lvl.goal_x,lvl.goal_z);
+  printf("bridges     %d\n",lvl.no_of_bridges);
+  printf("switches    %d\n",lvl.no_of_switches);
+  printf("hash        %08x\n",level_hash(&lvl));
+  printf("load        %.1f us\n",us);
+  return EXIT_SUCCESS;
+}
+
+/* The levels the game plays as 1, 2, ...: those of the pack, else
+   levels/levelN.blv or .txt, else the built-in ones */
+static void game_levels(const char *pack_path,std::vector<Level> *levels)
+{
+  LevelPack pack;
+  if(level_pack_open(pack_path,&pack))
+  {
+    levels->resize(pack.count);
+    for(int i=0;i<pack.count;i++)
+      if(!level_pack_level(&pack,i+1,&(*levels)[i]))
+      {
+        fprintf(stderr,"Level %d of %s is damaged\n",i+1,pack_path);
+        exit(EXIT_FAILURE);
+      }
+    return;
+  }
+  for(int n=1;;n++)
+  {
+    char path[64];
+    Level lvl;
+    snprintf(path,sizeof(path),"levels/level%d.blv",n);
+    if(access(path,R_OK)!=0)
+      snprintf(path,sizeof(path),"levels/level%d.txt",n);
+    if(access(path,R_OK)!=0)
+    {
+      snprintf(path,sizeof(path),"%d",n);
+      if(!builtin_level(n,&lvl))
+        return;
+    }
+    load_level(path,&lvl);
+    levels->push_back(lvl);
+  }
+}
+
+/* Publish the block after a headless roll, as the game does every tick */
+static void share_state(void *arg,int level,const Level *lvl,const SimState *s,int status,uint64_t tick)
+{
+  ObsRing *ring=(ObsRing *)arg;
+  uint8_t *tile;
+  ObsFrame *f=obs_ring_begin(ring,&tile);
+  f->tick=tick;
+  f->level=level;
+  f->width=f->depth=0;
+  if((uint64_t)lvl->width*lvl->depth<=ring->h->max_cells)
+  {
+    f->width=lvl->width;f->depth=lvl->depth;
+    memcpy(tile,lvl->tile,(size_t)lvl->width*lvl->depth);
+    for(int i=0;i<lvl->no_of_bridges;i++)
+      for(int k=0;k<2&&s->bridges>>i&1;k++)
+        tile[lvl->bridge[i].x[k]*lvl->depth+lvl->bridge[i].z[k]]=TILE_NORMAL;
+  }
+  f->x=s->x;f->z=s->z;f->orient=s->orient;
+  f->bridges=s->bridges;
+  f->cube=-1;
+  f->fall_status=status;
+  f->moving=0;
+  f->no_of_bridges=lvl->no_of_bridges;
+  for(int i=0;i<MAX_BRIDGES;i++)
+    f->bridge_angle[i]=i<lvl->no_of_bridges&&!(s->bridges>>i&1) ? 90 : 0;
+  obs_ring_publish(ring);
+}
+
+static int cmd_replay(int argc,char **argv)
+{
+  static const char *outcome[]={"ended","quit","completed","wrong level","unreadable"};
+  const char *pack_path="levels/levels.bxp",*share=NULL;
+  int threads=std::thread::hardware_concurrency();
+  std::vector<const char*> paths;
+  for(int i=0;i<argc;i++)
+  {
+    if(!strcmp(argv[i],"-threads")&&i+1<argc) threads=atoi(argv[++i]);
+    else if(!strcmp(argv[i],"-pack")&&i+1<argc) pack_path=argv[++i];
+    else if(!strcmp(argv[i],"-share")&&i+1<argc) share=argv[++i];
+    else if(argv[i][0]=='-') usage();
+    else paths.push_back(argv[i]);
+  }
+  int n=paths.size();
+  if(n==0)
+    usage();
+  std::vector<Level> levels;
+  game_levels(pack_path,&levels);
+  std::vector<const Level*> ptr(levels.size());
+  for(size_t i=0;i<levels.size();i++)
+    ptr[i]=&levels[i];
+  // The ring has one writer, so shared runs play one file after another
+  ObsRing ring;
+  if(share!=NULL)
+  {
+    size_t cells=0;
+    for(size_t i=0;i<levels.size();i++)
+      cells=std::max(cells,(size_t)levels[i].width*levels[i].depth);
+    if(!obs_ring_create(&ring,share,64,cells))
+    {
+      fprintf(stderr,"Could not create the shared memory ring %s\n",share);
+      return EXIT_FAILURE;
+    }
+    threads=1;
+  }
+  std::vector<ReplayResult> result(n);
+  std::chrono::steady_clock::time_point t0=std::chrono::steady_clock::now();
+  replay_run_files(&paths[0],n,ptr.empty() ? NULL : &ptr[0],ptr.size(),threads,
+                   share!=NULL ? share_state : NULL,&ring,&result[0]);
+  double seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+  if(share!=NULL)
+    obs_ring_close(&ring);
+
+  uint64_t rolls=0,ticks=0;
+  double busy=0;
+  int failed=0;
+  for(int i=0;i<n;i++)
+  {
+    const ReplayResult *r=&result[i];
+    if(r->outcome>=RUN_BAD_LEVEL)
+    {
+      printf("%-24s %s\n",paths[i],outcome[r->outcome]);
+      failed++;
+      continue;
+    }
+    printf("%-24s %-9s level %d at %d,%d %-8s %8llu rolls %6llu dropped %6llu restarts %9.1f s\n",
+           paths[i],outcome[r->outcome],r->level,r->state.x,r->state.z,
+           r->state.orient==STANDING ? "standing" : "lying",(unsigned long long)r->rolls,
+           (unsigned long long)r->dropped,(unsigned long long)r->restarts,
+           (double)r->end_tick/REPLAY_TICK_HZ);
+    rolls+=r->rolls;
+    ticks+=r->end_tick;
+    busy+=r->seconds;
+  }
+  fprintf(stderr,"played %d replays, %llu rolls and %.0f s of game in %.3f s (%.0fx real time), "
+          "%.3g rolls/s per core\n",n-failed,(unsigned long long)rolls,(double)ticks/REPLAY_TICK_HZ,
+          seconds,ticks/(double)REPLAY_TICK_HZ/seconds,busy>0 ? rolls/busy : 0.0);
+  return failed==0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* Follow an observation ring from another process and check every frame */
+static int cmd_watch(int argc,char **argv)
+{
+  const char *name=NULL;
+  double limit=10;
+  for(int i=0;i<argc;i++)
+  {
+    if(!strcmp(argv[i],"-seconds")&&i+1<argc) limit=atof(argv[++i]);
+    else if(argv[i][0]=='-'||name!=NULL) usage();
+    else name=argv[i];
+  }
+  if(name==NULL)
+    usage();
+  ObsRing ring;
+  if(!obs_ring_open(&ring,name))
+  {
+    fprintf(stderr,"Could not open the shared memory ring %s\n",name);
+    return EXIT_FAILURE;
+  }
+  uint32_t slots=ring.h->slot_count;
+  std::vector<uint8_t> tile(ring.h->max_cells);
+  ObsFrame f;
+  memset(&f,0,sizeof(f));
+  uint64_t next=obs_ring_head(&ring),first=next,read=0,lapped=0,bad=0;
+  std::chrono::steady_clock::time_point t0=std::chrono::steady_clock::now();
+  double seconds=0;
+  while(seconds<limit)
+  {
+    uint64_t head=obs_ring_head(&ring);
+    if(head-next>slots)
+    {
+      lapped+=head-slots-next;
+      next=head-slots;
+    }
+    int got=next<head ? obs_ring_read(&ring,next,&f,tile.data()) : 0;
+    if(got>0)
+    {
+      read++;
+      bad+=obs_frame_check(&f,tile.data())!=f.check;
+      next++;
+    }
+    else if(got<0)
+    {
+      lapped++;
+      next++;
+    }
+    else
+      std::this_thread::yield();
+    seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+  }
+  uint64_t published=obs_ring_head(&ring)-first;
+  if(read>0)
+    printf("last frame: tick %llu level %d block at %d,%d %s, fall_status %d, %dx%d tiles\n",
+           (unsigned long long)f.tick,f.level,f.x,f.z,f.orient==STANDING ? "standing" : "lying",
+           f.fall_status,f.width,f.depth);
+  printf("%llu frames published, %llu read (%.3g/s), %llu lapped, %llu failed the check\n",
+         (unsigned long long)published,(unsigned long long)read,read/seconds,
+         (unsigned long long)lapped,(unsigned long long)bad);
+  obs_ring_close(&ring);
+  return bad==0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* Random agents on the batched environment, for its throughput */
+static int cmd_env(int argc,char **argv)
+{
+  Level lvl;
+  int threads=std::thread::hardware_concurrency(),n=4096,limit=200;
+  uint64_t steps=10000;
+  bool render=false;
+  const char *level=NULL;
+  for(int i=0;i<argc;i++)
+  {
+    if(!strcmp(argv[i],"-threads")&&i+1<argc) threads=atoi(argv[++i]);
+    else if(!strcmp(argv[i],"-envs")&&i+1<argc) n=atoi(argv[++i]);
+    else if(!strcmp(argv[i],"-steps")&&i+1<argc) steps=strtoull(argv[++i],NULL,10);
+    else if(!strcmp(argv[i],"-limit")&&i+1<argc) limit=atoi(argv[++i]);
+    else if(!strcmp(argv[i],"-render")) render=true;
+    else if(argv[i][0]=='-'||level!=NULL) usage();
+    else level=argv[i];
+  }
+  if(level==NULL||n<1)
+    usage();
+  load_level(level,&lvl);
+  EnvBench r;
+  env_bench(&lvl,n,limit,threads,steps,render,&r);
+  printf("%d threads x %d games x %llu steps: %llu episodes, %llu won\n",threads,n,
+         (unsigned long long)steps,(unsigned long long)r.episodes,(unsigned long long)r.wins);
+  printf("%.3f s, %.3g steps/s, %.3g steps/s per thread\n",r.seconds,r.steps/r.seconds,
+         r.steps/r.seconds/std::max(1,threads));
+  if(render)
+    printf("%llu observations of %dx%dx%d bytes drawn, %.3g/s\n",(unsigned long long)r.rendered,
+           RASTER_PLANES,lvl.width,lvl.depth,r.rendered/r.seconds);
+  return EXIT_SUCCESS;
+}
+
+static bool by_difficulty(const std::pair<double,int> &a,const std::pair<double,int> &b)
+{
+  return a.first<b.first;
+}
+
+static int cmd_analyze(int argc,char **argv)
+{
+  GenParams p;
+  std::vector<Level> levels;
+  std::vector<std::string> names;
+  std::vector<GenLevel*> generated;
+  gen_default_params(&p);
+  p.count=0;
+  int threads=p.threads;
+  for(int i=0;i<argc;i++)
+  {
+    if(!strcmp(argv[i],"-threads")&&i+1<argc) threads=atoi(argv[++i]);
+    else if(!strcmp(argv[i],"-generate")&&i+1<argc) p.count=atoi(argv[++i]);
+    else if(!strcmp(argv[i],"-seed")&&i+1<argc) p.seed=strtoull(argv[++i],NULL,10);
+    else if(argv[i][0]=='-') usage();
+    else
+    {
+      Level lvl;
+      load_level(argv[i],&lvl);
+      levels.push_back(lvl);
+      names.push_back(argv[i]);
+    }
+  }
+  if(p.count>0)
+  {
+    GenStats gs;
+    p.min_length=1;p.max_length=1000;
+    p.threads=threads;
+    generate_levels(&p,&generated,&gs);
+    for(size_t i=0;i<generated.size();i++)
+    {
+      char name[32];
+      snprintf(name,sizeof(name),"gen%05d",(int)i);
+      levels.push_back(generated[i]->level.lvl);
+      names.push_back(name);
+    }
+  }
+  int n=levels.size();
+  if(n==0)
+    usage();
+  std::vector<const Level*> ptr(n);
+  std::vector<LevelMetrics> m(n);
+  for(int i=0;i<n;i++)
+    ptr[i]=&levels[i];
+  std::chrono::steady_clock::time_point t0=std::chrono::steady_clock::now();
+  analyze_levels(&ptr[0],n,threads,&m[0]);
+  double seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+
+  std::vector<std::pair<double,int> > rank(n);
+  for(int i=0;i<n;i++)
+    rank[i]=std::make_pair(m[i].difficulty,i);
+  std::stable_sort(rank.begin(),rank.end(),by_difficulty);
+  printf("%-12s %10s %6s %9s %10s %7s %10s\n","level","states","length","dead_ends","solutions","toggles","difficulty");
+  for(int r=0;r<n;r++)
+  {
+    const LevelMetrics *l=&m[rank[r].second];
+    printf("%-12s %10llu %6d %9.3f %10llu %7d %10.1f\n",names[rank[r].second].c_str(),
+           (unsigned long long)l->reachable,l->length,l->dead_ends,(unsigned long long)l->solutions,
+           l->toggles,l->difficulty);
+  }
+  fprintf(stderr,"analyzed %d levels in %.3f s\n",n,seconds);
+  for(size_t i=0;i<generated.size();i++)
+  {
+    owned_level_free(&generated[i]->level);
+    delete generated[i];
+  }
+  return EXIT_SUCCESS;
+}
+
+int main(int argc,char **argv)
+{
+  if(argc<2)
+    usage();
+  if(!strcmp(argv[1],"hints"))
+    return cmd_hints(argc-2,argv+2);
+  if(!strcmp(argv[1],"extbfs"))
+    return cmd_extbfs(argc-2,argv+2);
+  if(!strcmp(argv[1],"generate"))
+    return cmd_generate(argc-2,argv+2);
+  if(!strcmp(argv[1],"export"))
+    return cmd_export(argc-2,argv+2);
+  if(!strcmp(argv[1],"pack"))
+    return cmd_pack(argc-2,argv+2);
+  if(!strcmp(argv[1],"info"))
+    return cmd_info(argc-2,argv+2);
+  if(!strcmp(argv[1],"analyze"))
+    return cmd_analyze(argc-2,argv+2);
+  if(!strcmp(argv[1],"replay"))
+    return cmd_replay(argc-2,argv+2);
+  if(!strcmp(argv[1],"env"))
+    return cmd_env(argc-2,argv+2);
+  if(!strcmp(argv[1],"watch"))
+    return cmd_watch(argc-2,argv+2);
+  usage();
+  return EXIT_FAILURE;
+}
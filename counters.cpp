@@ -0,0 +1,117 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "counters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+const char *const counter_name[CTR_COUNT]={"cycles","instructions","cache_misses","branch_misses","dtlb_misses"};
+
+#ifdef __linux__
+static const uint32_t counter_type[CTR_COUNT]={
+  PERF_TYPE_HARDWARE,PERF_TYPE_HARDWARE,PERF_TYPE_HARDWARE,PERF_TYPE_HARDWARE,PERF_TYPE_HW_CACHE
+};
+static const uint64_t counter_config[CTR_COUNT]={
+  PERF_COUNT_HW_CPU_CYCLES,PERF_COUNT_HW_INSTRUCTIONS,PERF_COUNT_HW_CACHE_MISSES,PERF_COUNT_HW_BRANCH_MISSES,
+  PERF_COUNT_HW_CACHE_DTLB|PERF_COUNT_HW_CACHE_OP_READ<<8|PERF_COUNT_HW_CACHE_RESULT_MISS<<16
+};
+
+int counters_open(Counters *c)
+{
+  c->leader=-1;
+  c->open=0;
+  c->error[0]=0;
+  for(int i=0;i<CTR_COUNT;i++)
+  {
+    struct perf_event_attr a;
+    memset(&a,0,sizeof(a));
+    a.size=sizeof(a);
+    a.type=counter_type[i];
+    a.config=counter_config[i];
+    a.disabled=c->leader<0;
+    a.exclude_kernel=1;
+    a.exclude_hv=1;
+    a.read_format=PERF_FORMAT_GROUP|PERF_FORMAT_TOTAL_TIME_ENABLED|PERF_FORMAT_TOTAL_TIME_RUNNING;
+    c->fd[i]=syscall(SYS_perf_event_open,&a,0,-1,c->leader,0);
+    c->slot[i]=-1;
+    if(c->fd[i]<0)
+    {
+      if(c->error[0]==0)
+        snprintf(c->error,sizeof(c->error),"%s: %s",counter_name[i],strerror(errno));
+      continue;
+    }
+    if(c->leader<0)
+      c->leader=c->fd[i];
+    c->slot[i]=c->open++;
+  }
+  return c->open;
+}
+
+void counters_start(Counters *c)
+{
+  if(c->leader<0)
+    return;
+  ioctl(c->leader,PERF_EVENT_IOC_RESET,PERF_IOC_FLAG_GROUP);
+  ioctl(c->leader,PERF_EVENT_IOC_ENABLE,PERF_IOC_FLAG_GROUP);
+}
+
+int counters_stop(Counters *c,double *value)
+{
+  // nr, time enabled, time running, then a value per counter in open order
+  uint64_t buf[3+CTR_COUNT];
+  for(int i=0;i<CTR_COUNT;i++)
+    value[i]=-1;
+  if(c->leader<0)
+    return 0;
+  ioctl(c->leader,PERF_EVENT_IOC_DISABLE,PERF_IOC_FLAG_GROUP);
+  if(read(c->leader,buf,sizeof(buf))<(ssize_t)(3*sizeof(uint64_t))||buf[0]!=(uint64_t)c->open||buf[2]==0)
+    return 0;
+  double scale=(double)buf[1]/buf[2];
+  for(int i=0;i<CTR_COUNT;i++)
+    if(c->slot[i]>=0)
+      value[i]=buf[3+c->slot[i]]*scale;
+  return 1;
+}
+
+void counters_close(Counters *c)
+{
+  for(int i=0;i<CTR_COUNT;i++)
+    if(c->fd[i]>=0)
+      close(c->fd[i]);
+  for(int i=0;i<CTR_COUNT;i++)
+    c->fd[i]=c->slot[i]=-1;
+  c->leader=-1;
+  c->open=0;
+}
+#else
+int counters_open(Counters *c)
+{
+  for(int i=0;i<CTR_COUNT;i++)
+    c->fd[i]=c->slot[i]=-1;
+  c->leader=-1;
+  c->open=0;
+  snprintf(c->error,sizeof(c->error),"perf_event_open is Linux only");
+  return 0;
+}
+
+void counters_start(Counters *)
+{
+}
+
+int counters_stop(Counters *,double *value)
+{
+  for(int i=0;i<CTR_COUNT;i++)
+    value[i]=-1;
+  return 0;
+}
+
+void counters_close(Counters *)
+{
+}
+#endif
@@ -0,0 +1,42 @@
+#ifndef COUNTERS_H
+#define COUNTERS_H
+
+#include <stdint.h>
+
+/*
+ * Hardware performance counters around a region of code, through
+ * perf_event_open on Linux. The counters are one group, so they count over
+ * exactly the same instructions, and only in user space. Counters the CPU
+ * or the kernel does not offer are left out; where there is no PMU at all
+ * (other systems, most VMs, perf_event_paranoid) none open and callers fall
+ * back to timing alone.
+ */
+
+enum Counter {
+  CTR_CYCLES,
+  CTR_INSTRUCTIONS,
+  CTR_CACHE_MISSES,             // last level cache
+  CTR_BRANCH_MISSES,
+  CTR_DTLB_MISSES,              // data TLB read misses
+  CTR_COUNT
+};
+extern const char *const counter_name[CTR_COUNT];
+
+struct Counters {
+  int fd[CTR_COUNT];            // -1 where the counter did not open
+  int leader;                   // fd of the group, -1 if none opened
+  int slot[CTR_COUNT];          // place of the counter in a group read
+  int open;
+  char error[64];               // why the first counter did not open
+};
+
+/* Returns the number of counters opened, 0 to CTR_COUNT */
+int counters_open(Counters *c);
+void counters_start(Counters *c);
+/* value[i] gets counter i since counters_start, scaled up if the kernel had
+   to multiplex the group, and -1 for a counter that is not open. Returns 0
+   if the group never got onto the PMU */
+int counters_stop(Counters *c,double *value);
+void counters_close(Counters *c);
+
+#endif
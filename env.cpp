@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "env.h"
+#include "raster.h"
+
+using namespace std;
+
+void env_reset(EnvBatch *b,const Level *lvl,int n,int limit)
+{
+  int w=lvl->width,d=lvl->depth;
+  int pw=w+2*ENV_PAD,pd=d+2*ENV_PAD;
+  b->n=n;
+  b->limit=limit;
+  b->pd=pd;
+  b->tile.assign((size_t)pw*pd,TILE_EMPTY);
+  b->bridge.assign((size_t)pw*pd,0);
+  b->toggle.assign((size_t)pw*pd,0);
+  b->cells.assign((size_t)pw*pd,0);
+  for(int x=0;x<w;x++)
+    for(int z=0;z<d;z++)
+    {
+      size_t c=(size_t)(x+ENV_PAD)*pd+z+ENV_PAD;
+      b->tile[c]=lvl->tile[x*d+z];
+      b->cells[c]=(uint32_t)x*d+z;
+    }
+  for(int i=0;i<lvl->no_of_bridges;i++)
+    for(int k=0;k<2;k++)
+      b->bridge[(lvl->bridge[i].x[k]+ENV_PAD)*pd+lvl->bridge[i].z[k]+ENV_PAD]|=1u<<i;
+  for(int i=0;i<lvl->no_of_switches;i++)
+    b->toggle[(lvl->sw[i].x+ENV_PAD)*pd+lvl->sw[i].z+ENV_PAD]^=1u<<lvl->sw[i].bridge;
+  b->per_mask=(uint64_t)w*d*3;
+  b->start=(lvl->start_x+ENV_PAD)*pd+lvl->start_z+ENV_PAD;
+  b->goal=(lvl->goal_x+ENV_PAD)*pd+lvl->goal_z+ENV_PAD;
+  b->bridges_start=lvl->bridges_start;
+  for(int o=0;o<3;o++)
+    for(int m=0;m<4;m++)
+    {
+      b->dc[o*4+m]=roll_dx[o][m]*pd+roll_dz[o][m];
+      b->next_orient[o*4+m]=roll_orient[o][m];
+    }
+  b->cell.assign(n,b->start);
+  b->orient.assign(n,STANDING);
+  b->steps.assign(n,0);
+  b->bridges.assign(n,b->bridges_start);
+  b->status.assign(n,ST_OK);
+  b->stepped=b->episodes=b->wins=0;
+}
+
+/* sim_tile() on a padded cell */
+static inline int cell_tile(const EnvBatch *b,int c,uint32_t bridges)
+{
+  int t=b->tile[c];
+  return t+((t==TILE_EMPTY)&((b->bridge[c]&bridges)!=0));
+}
+
+/* sim_step() for every game, as masks */
+void env_step(EnvBatch *b,const uint8_t *action,uint64_t *obs,float *reward,uint8_t *done)
+{
+  int n=b->n,pd=b->pd;
+  int32_t *cell=&b->cell[0],*orient=&b->orient[0],*steps=&b->steps[0],*status=&b->status[0];
+  uint32_t *bridges=&b->bridges[0];
+  int limit=b->limit>0 ? b->limit : INT32_MAX;
+  uint64_t ended=0,wins=0;
+  for(int i=0;i<n;i++)
+  {
+    int r=orient[i]*4+(action[i]&3);
+    int c=cell[i]+b->dc[r],o=b->next_orient[r];
+    int c1=c+(o==LYING_X)*pd+(o==LYING_Z);
+    uint32_t br=bridges[i];
+    int t0=cell_tile(b,c,br),t1=cell_tile(b,c1,br);
+    int standing=o==STANDING;
+    int fall=(t0==TILE_EMPTY)|(t1==TILE_EMPTY);
+    int brk=standing&(t0==TILE_FRAGILE);
+    int win=standing&(c==b->goal)&!fall&!brk;
+    int press=!fall&!win&((standing&(t0==TILE_HEAVY))|((o==LYING_X)&(t0==TILE_SWITCH)));
+    br^=b->toggle[c]&-(uint32_t)press;
+    int st=fall*ST_FALL+brk*ST_BREAK+win*ST_WIN;
+    int step=steps[i]+1;
+    int end=(st!=ST_OK)|(step>=limit);
+    // Start over in place when the episode ended
+    uint32_t keep=end-1;
+    cell[i]=(c&keep)|(b->start&~keep);
+    orient[i]=o&keep;
+    bridges[i]=(br&keep)|(b->bridges_start&~keep);
+    steps[i]=step&keep;
+    status[i]=st;
+    ended+=end;
+    wins+=win;
+    if(reward!=NULL)
+      reward[i]=(float)(win-(fall|brk));
+    if(done!=NULL)
+      done[i]=end;
+  }
+  b->stepped+=n;
+  b->episodes+=ended;
+  b->wins+=wins;
+  if(obs!=NULL)
+    env_observe(b,obs);
+}
+
+void env_observe(const EnvBatch *b,uint64_t *obs)
+{
+  for(int i=0;i<b->n;i++)
+    obs[i]=b->bridges[i]*b->per_mask+(uint64_t)b->cells[b->cell[i]]*3+b->orient[i];
+}
+
+void env_state(const EnvBatch *b,int i,SimState *s)
+{
+  s->x=b->cell[i]/b->pd-ENV_PAD;
+  s->z=b->cell[i]%b->pd-ENV_PAD;
+  s->orient=b->orient[i];
+  s->bridges=b->bridges[i];
+}
+
+void env_bench(const Level *lvl,int n,int limit,int threads,uint64_t steps,bool render,EnvBench *r)
+{
+  threads=max(1,threads);
+  vector<EnvBench> part(threads);
+  vector<thread> pool;
+  chrono::steady_clock::time_point t0=chrono::steady_clock::now();
+  for(int t=0;t<threads;t++)
+    pool.push_back(thread([&,t]() {
+      EnvBatch b;
+      env_reset(&b,lvl,n,limit);
+      vector<uint8_t> action(n);
+      vector<uint64_t> obs(n);
+      vector<float> reward(n);
+      vector<uint8_t> done(n);
+      Raster raster;
+      vector<uint8_t> image;
+      if(render)
+      {
+        raster_init(&raster,lvl);
+        image.resize(n*raster.size);
+      }
+      uint64_t rng=0x9E3779B97F4A7C15ull*(t+1);
+      for(uint64_t k=0;k<steps;k++)
+      {
+        // xorshift, 2 bits per action
+        for(int i=0;i<n;i+=32)
+        {
+          rng^=rng<<13;rng^=rng>>7;rng^=rng<<17;
+          for(int j=0;j<32&&i+j<n;j++)
+            action[i+j]=rng>>2*j&3;
+        }
+        env_step(&b,&action[0],&obs[0],&reward[0],&done[0]);
+        if(render)
+          raster_env(&raster,&b,&image[0]);
+      }
+      part[t].rendered=render ? b.stepped : 0;
+      part[t].steps=b.stepped;
+      part[t].episodes=b.episodes;
+      part[t].wins=b.wins;
+    }));
+  for(int t=0;t<threads;t++)
+    pool[t].join();
+  r->seconds=chrono::duration<double>(chrono::steady_clock::now()-t0).count();
+  r->steps=r->episodes=r->wins=r->rendered=0;
+  for(int t=0;t<threads;t++)
+  {
+    r->steps+=part[t].steps;
+    r->episodes+=part[t].episodes;
+    r->wins+=part[t].wins;
+    r->rendered+=part[t].rendered;
+  }
+}
@@ -0,0 +1,66 @@
+#ifndef ENV_H
+#define ENV_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "sim.h"
+
+/*
+ * Batched environment for training agents: many independent games on one
+ * level, stepped in lockstep. The games are kept in parallel arrays and a
+ * step is one straight loop of table lookups and masks with no branches on
+ * the game state, so it runs at the same speed whatever the agents do.
+ *
+ * A block is kept by the padded cell of its lower half, so a roll is an
+ * add and no lookup needs a bounds check. An episode ends on a win, a fall
+ * or a break, or after limit steps; that game is reset in the same step, so
+ * the observation handed back is already the first one of the next episode.
+ */
+
+#define ENV_PAD 3               // cells of empty border around the level
+
+struct EnvBatch {
+  int n;                        // games
+  int limit;                    // steps per episode, 0 for no limit
+  // The level, compiled to padded cells
+  int pd;                       // padded depth, the stride of x
+  std::vector<uint8_t> tile;
+  std::vector<uint32_t> bridge;     // bridges covering the cell when closed
+  std::vector<uint32_t> toggle;     // bridges a switch on the cell toggles
+  std::vector<uint32_t> cells;      // level cell x*depth+z of the padded cell
+  uint64_t per_mask;                // states per bridge mask
+  int start,goal;
+  uint32_t bridges_start;
+  int dc[3*4],next_orient[3*4];     // roll tables in cell steps
+  // Per game
+  std::vector<int32_t> cell,orient,steps;
+  std::vector<uint32_t> bridges;
+  std::vector<int32_t> status;      // Status of the last step
+  // Totals
+  uint64_t stepped,episodes,wins;
+};
+
+/* Set up n games on lvl, all at the start */
+void env_reset(EnvBatch *b,const Level *lvl,int n,int limit);
+/*
+ * Play action[i] (a Move) in game i. obs[i] gets the sim_state_index of the
+ * new state, 64 bits like sim_state_count, reward[i] is 1 for a win, -1 for a fall or a break and 0
+ * otherwise, done[i] is set when the episode ended. Any output may be NULL.
+ */
+void env_step(EnvBatch *b,const uint8_t *action,uint64_t *obs,float *reward,uint8_t *done);
+void env_observe(const EnvBatch *b,uint64_t *obs);
+/* Game i as a SimState, in level cells */
+void env_state(const EnvBatch *b,int i,SimState *s);
+
+struct EnvBench {
+  uint64_t steps,episodes,wins;
+  uint64_t rendered;            // observations drawn with raster_env
+  double seconds;
+};
+
+/* Random play: threads batches of n games, steps steps each, drawing the
+   top-down observation of every game after each step if render is set */
+void env_bench(const Level *lvl,int n,int limit,int threads,uint64_t steps,bool render,EnvBench *r);
+
+#endif
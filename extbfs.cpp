@@ -0,0 +1,261 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <chrono>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "extbfs.h"
+
+using namespace std;
+
+/* Read only mapping of a sorted state file */
+struct StateFile {
+  const uint64_t *data;
+  size_t n;
+  size_t pos;
+  void *map;
+  size_t size;
+};
+
+static int map_states(const string &path,StateFile *f,ExtBfsStats *stats)
+{
+  memset(f,0,sizeof(*f));
+  int fd=open(path.c_str(),O_RDONLY);
+  if(fd<0)
+    return 0;
+  struct stat st;
+  if(fstat(fd,&st)!=0)
+  {
+    close(fd);
+    return 0;
+  }
+  f->size=st.st_size;
+  f->n=f->size/sizeof(uint64_t);
+  if(f->size>0)
+  {
+    f->map=mmap(NULL,f->size,PROT_READ,MAP_SHARED,fd,0);
+    if(f->map==MAP_FAILED)
+    {
+      close(fd);
+      return 0;
+    }
+    madvise(f->map,f->size,MADV_SEQUENTIAL);
+    f->data=(const uint64_t *)f->map;
+  }
+  close(fd);
+  stats->bytes_read+=f->size;
+  return 1;
+}
+
+static void unmap_states(StateFile *f)
+{
+  if(f->size>0)
+    munmap(f->map,f->size);
+  memset(f,0,sizeof(*f));
+}
+
+/* Buffered appender for a state file */
+struct StateWriter {
+  FILE *file;
+  uint64_t buf[8192];
+  int n;
+  uint64_t count;
+};
+
+static int open_writer(const string &path,StateWriter *w)
+{
+  w->file=fopen(path.c_str(),"wb");
+  w->n=0;
+  w->count=0;
+  return w->file!=NULL;
+}
+
+/* 0 when the disk is full or failed */
+static int flush_writer(StateWriter *w,ExtBfsStats *stats)
+{
+  int ok=fwrite(w->buf,sizeof(uint64_t),w->n,w->file)==(size_t)w->n;
+  stats->bytes_written+=w->n*sizeof(uint64_t);
+  w->n=0;
+  return ok;
+}
+
+static int write_state(StateWriter *w,uint64_t v,ExtBfsStats *stats)
+{
+  w->buf[w->n++]=v;
+  w->count++;
+  return w->n<8192||flush_writer(w,stats);
+}
+
+static int close_writer(StateWriter *w,ExtBfsStats *stats)
+{
+  int ok=flush_writer(w,stats);
+  return (fclose(w->file)==0)&&ok;
+}
+
+static string layer_path(const char *dir,int d)
+{
+  char name[32];
+  snprintf(name,sizeof(name),"/layer%05d.bin",d);
+  return dir+string(name);
+}
+
+static string run_path(const char *dir,int r)
+{
+  char name[32];
+  snprintf(name,sizeof(name),"/run%05d.bin",r);
+  return dir+string(name);
+}
+
+/* Sort the buffered successors and spill them as one run */
+static int spill_run(const char *dir,vector<uint64_t> &buf,int run,ExtBfsStats *stats)
+{
+  sort(buf.begin(),buf.end());
+  buf.erase(unique(buf.begin(),buf.end()),buf.end());
+  StateWriter w;
+  if(!open_writer(run_path(dir,run),&w))
+    return 0;
+  int ok=1;
+  for(size_t i=0;i<buf.size()&&ok;i++)
+    ok=write_state(&w,buf[i],stats);
+  buf.clear();
+  return close_writer(&w,stats)&&ok;
+}
+
+/*
+ * Merge the runs into layer d+1, dropping states already in layers first..d.
+ * Without switches every roll can be rolled back, so a successor of layer d
+ * is in layer d-1, d or d+1 and first is d-1. A switch toggles on the way in
+ * but not on the way out, so with switches the graph is directed and every
+ * layer is checked: the I/O then grows with the square of the depth.
+ */
+static int merge_runs(const char *dir,int runs,int first,int d,uint64_t *count,ExtBfsStats *stats)
+{
+  vector<StateFile> run(runs),old(d+1);
+  typedef pair<uint64_t,int> Head;
+  priority_queue<Head,vector<Head>,greater<Head> > heap;
+  int ok=1;
+  for(int r=0;r<runs;r++)
+  {
+    ok&=map_states(run_path(dir,r),&run[r],stats);
+    if(run[r].n>0)
+      heap.push(Head(run[r].data[0],r));
+  }
+  for(int i=first;i<=d;i++)
+    ok&=map_states(layer_path(dir,i),&old[i],stats);
+  StateWriter w;
+  w.file=NULL;
+  w.count=0;
+  ok=ok&&open_writer(layer_path(dir,d+1),&w);
+  bool have_last=false;
+  uint64_t last=0;
+  while(ok&&!heap.empty())
+  {
+    Head h=heap.top();
+    heap.pop();
+    StateFile *f=&run[h.second];
+    if(++f->pos<f->n)
+      heap.push(Head(f->data[f->pos],h.second));
+    if(have_last&&h.first==last)
+      continue;
+    have_last=true;
+    last=h.first;
+    bool seen=false;
+    for(int i=first;i<=d&&!seen;i++)
+    {
+      StateFile *o=&old[i];
+      while(o->pos<o->n&&o->data[o->pos]<h.first)
+        o->pos++;
+      seen=o->pos<o->n&&o->data[o->pos]==h.first;
+    }
+    if(!seen)
+      ok=write_state(&w,h.first,stats);
+  }
+  if(w.file!=NULL)
+    ok=close_writer(&w,stats)&&ok;
+  for(int r=0;r<runs;r++)
+  {
+    unmap_states(&run[r]);
+    unlink(run_path(dir,r).c_str());
+  }
+  for(int i=first;i<=d;i++)
+    unmap_states(&old[i]);
+  *count=ok ? w.count : 0;
+  return ok;
+}
+
+int ext_bfs(const Level *lvl,const char *dir,size_t mem_limit,ExtBfsStats *stats)
+{
+  chrono::steady_clock::time_point t0=chrono::steady_clock::now();
+  memset(stats,0,sizeof(*stats));
+  stats->goal_depth=-1;
+  size_t cap=max(mem_limit,(size_t)1<<20)/sizeof(uint64_t);
+  vector<uint64_t> buf;
+  buf.reserve(cap);
+
+  SimState s,t;
+  sim_reset(lvl,&s);
+  StateWriter w;
+  if(!open_writer(layer_path(dir,0),&w))
+    return 0;
+  int ok=write_state(&w,sim_state_index(lvl,&s),stats);
+  if(!close_writer(&w,stats)||!ok)
+  {
+    unlink(layer_path(dir,0).c_str());
+    return 0;
+  }
+  stats->states=1;
+
+  int d;
+  for(d=0;ok;d++)
+  {
+    StateFile layer;
+    if(!map_states(layer_path(dir,d),&layer,stats))
+    {
+      ok=0;
+      break;
+    }
+    if(layer.n==0)
+    {
+      unmap_states(&layer);
+      break;
+    }
+    int runs=0;
+    for(size_t i=0;i<layer.n&&ok;i++)
+    {
+      sim_state_from_index(lvl,layer.data[i],&s);
+      for(int m=0;m<4;m++)
+      {
+        t=s;
+        int status=sim_step(lvl,&t,m);
+        if(status==ST_WIN&&stats->goal_depth<0)
+          stats->goal_depth=d+1;
+        if(status!=ST_OK)
+          continue;
+        buf.push_back(sim_state_index(lvl,&t));
+        if(buf.size()==cap)
+          ok=spill_run(dir,buf,runs++,stats);
+      }
+    }
+    unmap_states(&layer);
+    if(ok&&(runs==0||!buf.empty()))
+      ok=spill_run(dir,buf,runs++,stats);
+    uint64_t count=0;
+    if(ok)
+      ok=merge_runs(dir,runs,lvl->no_of_switches==0 ? max(d-1,0) : 0,d,&count,stats);
+    else
+      for(int r=0;r<runs;r++)
+        unlink(run_path(dir,r).c_str());
+    stats->states+=count;
+  }
+  stats->layers=d;
+  for(int i=0;i<=d;i++)
+    unlink(layer_path(dir,i).c_str());
+  stats->seconds=chrono::duration<double>(chrono::steady_clock::now()-t0).count();
+  return ok;
+}
@@ -0,0 +1,26 @@
+#ifndef EXTBFS_H
+#define EXTBFS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sim.h"
+
+/*
+ * Disk backed breadth first search over sim state indices. Every BFS layer
+ * is a sorted file of uint64 indices in dir. Successors are sorted in runs
+ * that fit in mem_limit bytes, merged, and duplicates against the previous
+ * layers are dropped during the merge, so only one run has to fit in RAM.
+ */
+
+struct ExtBfsStats {
+  uint64_t states;              // distinct reachable states
+  int layers;
+  int goal_depth;               // rolls to the goal, -1 if unsolvable
+  uint64_t bytes_read,bytes_written;
+  double seconds;
+};
+
+int ext_bfs(const Level *lvl,const char *dir,size_t mem_limit,ExtBfsStats *stats);
+
+#endif
@@ -0,0 +1,227 @@
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include "generator.h"
+
+using namespace std;
+
+#define MAX_CANDIDATES ((uint64_t)1<<26)
+
+/* xorshift64*, seeded through splitmix64 */
+struct Rng { uint64_t s; };
+
+static void rng_seed(Rng *r,uint64_t seed,uint64_t index)
+{
+  uint64_t z=seed+index*0x9E3779B97F4A7C15ull;
+  z=(z^(z>>30))*0xBF58476D1CE4E5B9ull;
+  z=(z^(z>>27))*0x94D049BB133111EBull;
+  r->s=(z^(z>>31))|1;
+}
+
+static uint64_t rng_next(Rng *r)
+{
+  r->s^=r->s>>12;r->s^=r->s<<25;r->s^=r->s>>27;
+  return r->s*0x2545F4914F6CDD1Dull;
+}
+
+static int rng_int(Rng *r,int n)
+{
+  return (int)((rng_next(r)>>32)*(uint64_t)n>>32);
+}
+
+static double rng_real(Rng *r)
+{
+  return (rng_next(r)>>11)*(1.0/9007199254740992.0);
+}
+
+void gen_default_params(GenParams *p)
+{
+  p->width=p->depth=14;
+  p->density=0.35;
+  p->fragile=0.05;
+  p->bridges=1;
+  p->min_length=12;p->max_length=40;
+  p->min_branching=0;
+  p->seed=1;
+  p->count=100;
+  p->threads=thread::hardware_concurrency();
+}
+
+static int random_tile(Rng *r,const OwnedLevel *o,int *x,int *z)
+{
+  int w=o->lvl.width,d=o->lvl.depth;
+  for(int tries=0;tries<1000;tries++)
+  {
+    *x=rng_int(r,w);*z=rng_int(r,d);
+    if(o->tile[*x*d+*z]==TILE_NORMAL)
+      return 1;
+  }
+  return 0;
+}
+
+int generate_candidate(const GenParams *p,uint64_t index,OwnedLevel *o)
+{
+  Rng r;
+  rng_seed(&r,p->seed,index);
+  Level *l=&o->lvl;
+  int w=l->width,d=l->depth;
+  memset(o->tile,0,(size_t)w*d);
+  l->no_of_bridges=l->no_of_switches=0;
+  l->bridges_start=0;
+
+  // Carve a connected area with a random walk that sometimes jumps back
+  int target=max(8,(int)(p->density*w*d)),carved=0;
+  int x=rng_int(&r,w),z=rng_int(&r,d);
+  for(long step=0;carved<target&&step<20L*target;step++)
+  {
+    if(o->tile[x*d+z]==0)
+    {
+      o->tile[x*d+z]=TILE_NORMAL;
+      carved++;
+    }
+    if(rng_int(&r,10)==0)
+      random_tile(&r,o,&x,&z);
+    int k=rng_int(&r,4);
+    int nx=x+(k==0)-(k==1),nz=z+(k==2)-(k==3);
+    if(nx>=0&&nz>=0&&nx<w&&nz<d)
+    {
+      x=nx;z=nz;
+    }
+  }
+  if(!random_tile(&r,o,&l->start_x,&l->start_z))
+    return 0;
+  // Goal: the farthest of a few random picks
+  int best=-1;
+  for(int k=0;k<8;k++)
+  {
+    int gx,gz;
+    if(!random_tile(&r,o,&gx,&gz))
+      continue;
+    int dist=abs(gx-l->start_x)+abs(gz-l->start_z);
+    if(dist>best)
+    {
+      best=dist;
+      l->goal_x=gx;l->goal_z=gz;
+    }
+  }
+  if(best<=0)
+    return 0;
+
+  for(int i=0;i<w*d;i++)
+  {
+    int cx=i/d,cz=i%d;
+    if(o->tile[i]==TILE_NORMAL&&rng_real(&r)<p->fragile&&
+       !(cx==l->start_x&&cz==l->start_z)&&!(cx==l->goal_x&&cz==l->goal_z))
+      o->tile[i]=TILE_FRAGILE;
+  }
+
+  for(int b=0;b<p->bridges&&b<MAX_BRIDGES;b++)
+  {
+    for(int tries=0;tries<20;tries++)
+    {
+      int bx,bz,sx,sz;
+      if(!random_tile(&r,o,&bx,&bz))
+        break;
+      int along_x=rng_int(&r,2);
+      int ex=bx+along_x,ez=bz+!along_x;
+      if(ex>=w||ez>=d||o->tile[ex*d+ez]!=TILE_NORMAL)
+        continue;
+      if((bx==l->start_x&&bz==l->start_z)||(ex==l->start_x&&ez==l->start_z)||
+         (bx==l->goal_x&&bz==l->goal_z)||(ex==l->goal_x&&ez==l->goal_z))
+        continue;
+      o->tile[bx*d+bz]=o->tile[ex*d+ez]=TILE_EMPTY;
+      if(!random_tile(&r,o,&sx,&sz)||(sx==l->start_x&&sz==l->start_z)||(sx==l->goal_x&&sz==l->goal_z))
+      {
+        o->tile[bx*d+bz]=o->tile[ex*d+ez]=TILE_NORMAL;
+        continue;
+      }
+      o->tile[sx*d+sz]=rng_int(&r,2) ? TILE_SWITCH : TILE_HEAVY;
+      SimBridge nb={{(int16_t)bx,(int16_t)ex},{(int16_t)bz,(int16_t)ez}};
+      SimSwitch ns={(int16_t)sx,(int16_t)sz,(int16_t)l->no_of_bridges,0};
+      o->bridge[l->no_of_bridges++]=nb;
+      o->sw[l->no_of_switches++]=ns;
+      break;
+    }
+  }
+  l->no_of_tiles=level_spawn_order(l,o->tile,o->order,NULL);
+  return 1;
+}
+
+static GenLevel *keep_level(const OwnedLevel *src,uint64_t index,const SolveResult *result)
+{
+  GenLevel *g=new GenLevel;
+  OwnedLevel *o=&g->level;
+  owned_level_alloc(o,src->lvl.width,src->lvl.depth);
+  size_t cells=(size_t)src->lvl.width*src->lvl.depth;
+  memcpy(o->tile,src->tile,cells);
+  memcpy(o->order,src->order,cells*2*sizeof(int16_t));
+  memcpy(o->bridge,src->bridge,sizeof(o->bridge));
+  memcpy(o->sw,src->sw,sizeof(o->sw));
+  o->lvl=src->lvl;
+  o->lvl.tile=o->tile;o->lvl.tile_order=o->order;
+  o->lvl.bridge=o->bridge;o->lvl.sw=o->sw;
+  g->index=index;
+  g->result=*result;
+  return g;
+}
+
+static bool by_index(const GenLevel *a,const GenLevel *b)
+{
+  return a->index<b->index;
+}
+
+int generate_levels(const GenParams *p,vector<GenLevel*> *out,GenStats *stats)
+{
+  chrono::steady_clock::time_point t0=chrono::steady_clock::now();
+  atomic<uint64_t> next(0);
+  atomic<int> found(0);
+  mutex lock;
+  vector<GenLevel*> kept;
+  vector<thread> pool;
+
+  // Candidates are taken in order and every one taken is finished, so once
+  // count levels are found all below the last taken are in: the lowest
+  // count of them are the kept set, whatever the threads did
+  for(int t=0;t<max(1,p->threads);t++)
+    pool.push_back(thread([&]() {
+      OwnedLevel scratch;
+      SolverWork work;
+      SolveResult result;
+      owned_level_alloc(&scratch,p->width,p->depth);
+      while(found<p->count)
+      {
+        uint64_t i=next++;
+        if(i>=MAX_CANDIDATES)
+          break;
+        if(!generate_candidate(p,i,&scratch))
+          continue;
+        solve_level(&scratch.lvl,&work,&result);
+        if(result.length<p->min_length||result.length>p->max_length||
+           result.branching<p->min_branching)
+          continue;
+        GenLevel *g=keep_level(&scratch,i,&result);
+        lock_guard<mutex> guard(lock);
+        kept.push_back(g);
+        found++;
+      }
+      owned_level_free(&scratch);
+    }));
+  for(size_t t=0;t<pool.size();t++)
+    pool[t].join();
+  sort(kept.begin(),kept.end(),by_index);
+  while(kept.size()>(size_t)p->count)
+  {
+    owned_level_free(&kept.back()->level);
+    delete kept.back();
+    kept.pop_back();
+  }
+  out->insert(out->end(),kept.begin(),kept.end());
+  stats->tried=min((uint64_t)next,MAX_CANDIDATES);
+  stats->seconds=chrono::duration<double>(chrono::steady_clock::now()-t0).count();
+  return (int)kept.size();
+}
@@ -0,0 +1,43 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "sim.h"
+#include "solver.h"
+
+/*
+ * Random level generator. Candidate i is built from its own RNG stream
+ * seeded with (seed,i), so the kept levels only depend on the parameters,
+ * never on the number of threads.
+ */
+
+struct GenParams {
+  int width,depth;
+  double density;               // fraction of cells carrying a tile
+  double fragile;               // fraction of tiles that are fragile
+  int bridges;                  // bridges, each with one switch
+  int min_length,max_length;    // target band for the optimal solution
+  double min_branching;         // average safe rolls per reachable state
+  uint64_t seed;
+  int count;                    // levels to keep
+  int threads;
+};
+
+struct GenLevel {
+  OwnedLevel level;
+  uint64_t index;               // candidate number the level came from
+  SolveResult result;
+};
+
+struct GenStats {
+  uint64_t tried;
+  double seconds;
+};
+
+void gen_default_params(GenParams *p);
+int generate_candidate(const GenParams *p,uint64_t index,OwnedLevel *o);
+int generate_levels(const GenParams *p,std::vector<GenLevel*> *out,GenStats *stats);
+
+#endif
@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <vector>
+
+#include "hint.h"
+
+#define WIN_EDGE 0xFFFFFFFEu
+#define NO_EDGE  0xFFFFFFFFu
+
+int hint_table_build(const Level *lvl,HintTable *table)
+{
+  uint64_t count=sim_state_count(lvl);
+  memset(table,0,sizeof(*table));
+  table->level_hash=level_hash(lvl);
+  table->count=count;
+  table->owned=new uint16_t[count];
+  table->entry=table->owned;
+  for(uint64_t i=0;i<count;i++)
+    table->owned[i]=0xFFFF;
+
+  // Forward BFS from the start. order[] numbers the reachable states
+  std::vector<uint32_t> order(count,NO_EDGE);
+  std::vector<uint64_t> reach;
+  SimState s,t;
+  sim_reset(lvl,&s);
+  uint64_t start=sim_state_index(lvl,&s);
+  order[start]=0;
+  reach.push_back(start);
+  std::vector<uint32_t> succ;
+  for(size_t i=0;i<reach.size();i++)
+  {
+    sim_state_from_index(lvl,reach[i],&s);
+    for(int m=0;m<4;m++)
+    {
+      t=s;
+      int status=sim_step(lvl,&t,m);
+      uint32_t edge=NO_EDGE;
+      if(status==ST_WIN)
+        edge=WIN_EDGE;
+      else if(status==ST_OK)
+      {
+        uint64_t j=sim_state_index(lvl,&t);
+        if(order[j]==NO_EDGE)
+        {
+          order[j]=reach.size();
+          reach.push_back(j);
+        }
+        edge=order[j];
+      }
+      succ.push_back(edge);
+    }
+  }
+
+  // Reverse edges, grouped by target. Each one is (source<<2|move)
+  size_t n=reach.size();
+  std::vector<uint32_t> first(n+1,0),pred;
+  for(size_t e=0;e<succ.size();e++)
+    if(succ[e]<n)
+      first[succ[e]+1]++;
+  for(size_t i=0;i<n;i++)
+    first[i+1]+=first[i];
+  pred.resize(first[n]);
+  std::vector<uint32_t> fill(first.begin(),first.end()-1);
+  for(size_t e=0;e<succ.size();e++)
+    if(succ[e]<n)
+      pred[fill[succ[e]]++]=(uint32_t)(e/4)<<2|(e%4);
+
+  // Backward BFS from the states one roll away from the goal
+  std::vector<uint32_t> queue;
+  std::vector<uint16_t> dist(n,HINT_NONE);
+  for(size_t e=0;e<succ.size();e++)
+    if(succ[e]==WIN_EDGE&&dist[e/4]==HINT_NONE)
+    {
+      dist[e/4]=1;
+      table->owned[reach[e/4]]=1<<2|(e%4);
+      queue.push_back(e/4);
+    }
+  for(size_t q=0;q<queue.size();q++)
+  {
+    uint32_t v=queue[q];
+    int d=dist[v]+1;
+    if(d>=HINT_NONE)
+      break;
+    for(uint32_t k=first[v];k<first[v+1];k++)
+    {
+      uint32_t u=pred[k]>>2;
+      if(dist[u]!=HINT_NONE)
+        continue;
+      dist[u]=d;
+      table->owned[reach[u]]=d<<2|(pred[k]&3);
+      queue.push_back(u);
+    }
+  }
+  return 1;
+}
+
+int hint_table_save(const HintTable *table,const char *path)
+{
+  FILE *f=fopen(path,"wb");
+  if(f==NULL)
+    return 0;
+  HintHeader h;
+  memcpy(h.magic,"BXHT",4);
+  h.version=1;
+  h.level_hash=table->level_hash;
+  h.pad=0;
+  h.count=table->count;
+  int ok=fwrite(&h,sizeof(h),1,f)==1 &&
+         fwrite(table->entry,sizeof(uint16_t),table->count,f)==table->count;
+  return fclose(f)==0&&ok;
+}
+
+int hint_table_view(const void *data,size_t size,uint32_t level_hash,HintTable *table)
+{
+  memset(table,0,sizeof(*table));
+  const HintHeader *h=(const HintHeader *)data;
+  if(size<sizeof(HintHeader)||memcmp(h->magic,"BXHT",4)!=0||h->version!=1||
+     h->level_hash!=level_hash||h->count>(size-sizeof(HintHeader))/sizeof(uint16_t))
+    return 0;
+  table->level_hash=h->level_hash;
+  table->count=h->count;
+  table->entry=(const uint16_t *)(h+1);
+  return 1;
+}
+
+int hint_table_map(const char *path,uint32_t level_hash,HintTable *table)
+{
+  memset(table,0,sizeof(*table));
+  int fd=open(path,O_RDONLY);
+  if(fd<0)
+    return 0;
+  struct stat st;
+  void *map=MAP_FAILED;
+  if(fstat(fd,&st)==0&&(size_t)st.st_size>=sizeof(HintHeader))
+    map=mmap(NULL,st.st_size,PROT_READ,MAP_SHARED,fd,0);
+  close(fd);
+  if(map==MAP_FAILED)
+    return 0;
+  if(!hint_table_view(map,st.st_size,level_hash,table))
+  {
+    munmap(map,st.st_size);
+    return 0;
+  }
+  table->map=map;
+  table->map_size=st.st_size;
+  return 1;
+}
+
+void hint_table_free(HintTable *table)
+{
+  if(table->map!=NULL)
+    munmap(table->map,table->map_size);
+  delete[] table->owned;
+  memset(table,0,sizeof(*table));
+}
@@ -0,0 +1,52 @@
+#ifndef HINT_H
+#define HINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sim.h"
+
+/*
+ * Distance-to-goal table for a level, one 16 bit entry per state index:
+ * the low 2 bits are the best Move, the high 14 bits the rolls left.
+ * Built once with a BFS, then looked up while playing.
+ */
+
+#define HINT_NONE 0x3FFF       // distance of unreachable or unsolvable states
+
+struct HintTable {
+  uint32_t level_hash;
+  uint64_t count;
+  const uint16_t *entry;
+  uint16_t *owned;              // heap copy when built here
+  void *map;                    // file mapping when loaded with hint_table_map
+  size_t map_size;
+};
+
+/* File layout: HintHeader followed by count entries */
+struct HintHeader {
+  char magic[4];                // "BXHT"
+  uint32_t version;
+  uint32_t level_hash;
+  uint32_t pad;
+  uint64_t count;
+};
+
+int hint_table_build(const Level *lvl,HintTable *table);
+int hint_table_save(const HintTable *table,const char *path);
+int hint_table_map(const char *path,uint32_t level_hash,HintTable *table);
+/* Point table at a HintHeader and entries in memory, e.g. inside a level pack */
+int hint_table_view(const void *data,size_t size,uint32_t level_hash,HintTable *table);
+void hint_table_free(HintTable *table);
+
+static inline int hint_distance(const HintTable *table,uint64_t index)
+{
+  return index<table->count ? table->entry[index]>>2 : HINT_NONE;
+}
+
+static inline int hint_move(const HintTable *table,uint64_t index)
+{
+  return table->entry[index]&3;
+}
+
+#endif
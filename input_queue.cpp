@@ -0,0 +1,43 @@
+#include "input_queue.h"
+
+void iq_init(InputQueue *q,int depth)
+{
+  q->depth=depth<1 ? 1 : depth>INPUT_QUEUE_MAX ? INPUT_QUEUE_MAX : depth;
+  q->head=q->count=0;
+  q->popped=q->dropped=0;
+  q->wait=q->max_wait=0;
+}
+
+int iq_push(InputQueue *q,char key,double time)
+{
+  if(q->count==q->depth)
+  {
+    q->dropped++;
+    return 0;
+  }
+  InputEvent *e=&q->event[(q->head+q->count)%q->depth];
+  e->key=key;
+  e->time=time;
+  q->count++;
+  return 1;
+}
+
+int iq_pop(InputQueue *q,InputEvent *e,double now)
+{
+  if(q->count==0)
+    return 0;
+  *e=q->event[q->head];
+  q->head=(q->head+1)%q->depth;
+  q->count--;
+  double wait=now-e->time;
+  q->popped++;
+  q->wait+=wait;
+  if(wait>q->max_wait)
+    q->max_wait=wait;
+  return 1;
+}
+
+void iq_clear(InputQueue *q)
+{
+  q->head=q->count=0;
+}
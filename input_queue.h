@@ -0,0 +1,35 @@
+#ifndef INPUT_QUEUE_H
+#define INPUT_QUEUE_H
+
+#include <stdint.h>
+
+/*
+ * Bounded FIFO of rolls. The GLFW callbacks push a roll with the time it
+ * came in, the game pops one whenever the block is free to move, so
+ * presses made during a roll play right after it instead of being lost.
+ * A full queue drops the new press.
+ */
+
+#define INPUT_QUEUE_MAX 1024
+
+struct InputEvent {
+  char key;                     // a move_key letter
+  double time;                  // glfwGetTime() when it came in
+};
+
+struct InputQueue {
+  InputEvent event[INPUT_QUEUE_MAX];
+  int depth;                    // capacity in use, 1..INPUT_QUEUE_MAX
+  int head,count;
+  // Time from push to pop, for the latency report
+  uint64_t popped,dropped;
+  double wait,max_wait;
+};
+
+void iq_init(InputQueue *q,int depth);
+int iq_push(InputQueue *q,char key,double time);
+/* Take the oldest event, now is when it starts to play */
+int iq_pop(InputQueue *q,InputEvent *e,double now);
+void iq_clear(InputQueue *q);
+
+#endif
@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "level_file.h"
+
+#ifndef MAP_POPULATE
+#define MAP_POPULATE 0
+#endif
+
+static size_t align8(size_t n)
+{
+  return (n+7)&~(size_t)7;
+}
+
+static void layout(const Level *lvl,LevelFileHeader *h)
+{
+  memset(h,0,sizeof(*h));
+  memcpy(h->magic,"BXLV",4);
+  h->version=LEVEL_FILE_VERSION;
+  h->header_size=sizeof(LevelFileHeader);
+  h->width=lvl->width;h->depth=lvl->depth;
+  h->start_x=lvl->start_x;h->start_z=lvl->start_z;
+  h->goal_x=lvl->goal_x;h->goal_z=lvl->goal_z;
+  h->no_of_tiles=lvl->no_of_tiles;
+  h->no_of_bridges=lvl->no_of_bridges;
+  h->no_of_switches=lvl->no_of_switches;
+  h->bridges_start=lvl->bridges_start;
+  size_t at=align8(sizeof(LevelFileHeader));
+  h->tile_offset=at;
+  at=align8(at+(size_t)lvl->width*lvl->depth);
+  h->order_offset=at;
+  at=align8(at+(size_t)lvl->no_of_tiles*2*sizeof(int16_t));
+  h->bridge_offset=at;
+  at+=lvl->no_of_bridges*sizeof(SimBridge);
+  h->switch_offset=at;
+  at+=lvl->no_of_switches*sizeof(SimSwitch);
+  h->file_size=at;
+  h->level_hash=level_hash(lvl);
+}
+
+size_t level_file_size(const Level *lvl)
+{
+  LevelFileHeader h;
+  layout(lvl,&h);
+  return h.file_size;
+}
+
+void level_file_encode(const Level *lvl,void *buf)
+{
+  LevelFileHeader h;
+  layout(lvl,&h);
+  char *p=(char *)buf;
+  memset(p,0,h.file_size);
+  memcpy(p,&h,sizeof(h));
+  memcpy(p+h.tile_offset,lvl->tile,(size_t)lvl->width*lvl->depth);
+  memcpy(p+h.order_offset,lvl->tile_order,(size_t)lvl->no_of_tiles*2*sizeof(int16_t));
+  memcpy(p+h.bridge_offset,lvl->bridge,lvl->no_of_bridges*sizeof(SimBridge));
+  memcpy(p+h.switch_offset,lvl->sw,lvl->no_of_switches*sizeof(SimSwitch));
+}
+
+int level_file_write(const char *path,const Level *lvl)
+{
+  size_t size=level_file_size(lvl);
+  char *buf=new char[size];
+  level_file_encode(lvl,buf);
+  FILE *f=fopen(path,"wb");
+  int ok=f!=NULL&&fwrite(buf,1,size,f)==size;
+  if(f!=NULL&&fclose(f)!=0)
+    ok=0;
+  delete[] buf;
+  return ok;
+}
+
+int level_file_view(const void *data,size_t size,Level *lvl)
+{
+  const LevelFileHeader *h=(const LevelFileHeader *)data;
+  const char *p=(const char *)data;
+  if((uintptr_t)data%8!=0||size<sizeof(LevelFileHeader)||memcmp(h->magic,"BXLV",4)!=0||
+     h->version!=LEVEL_FILE_VERSION||h->header_size!=sizeof(LevelFileHeader)||h->file_size>size)
+    return 0;
+  if(h->width<=0||h->depth<=0||h->width>32767||h->depth>32767||
+     h->no_of_tiles<0||h->no_of_bridges<0||h->no_of_bridges>MAX_BRIDGES||
+     h->no_of_switches<0||h->no_of_switches>MAX_SWITCHES)
+    return 0;
+  if((uint64_t)h->tile_offset+(uint64_t)h->width*h->depth>h->file_size||
+     (uint64_t)h->order_offset+(uint64_t)h->no_of_tiles*4>h->file_size||
+     (uint64_t)h->bridge_offset+h->no_of_bridges*sizeof(SimBridge)>h->file_size||
+     (uint64_t)h->switch_offset+h->no_of_switches*sizeof(SimSwitch)>h->file_size||
+     h->order_offset%2!=0||h->bridge_offset%2!=0||h->switch_offset%2!=0)
+    return 0;
+  if(h->start_x<0||h->start_z<0||h->start_x>=h->width||h->start_z>=h->depth||
+     h->goal_x<0||h->goal_z<0||h->goal_x>=h->width||h->goal_z>=h->depth||
+     (h->start_x==h->goal_x&&h->start_z==h->goal_z))
+    return 0;
+  lvl->width=h->width;lvl->depth=h->depth;
+  lvl->tile=(const uint8_t *)(p+h->tile_offset);
+  lvl->no_of_tiles=h->no_of_tiles;
+  lvl->tile_order=(const int16_t *)(p+h->order_offset);
+  lvl->start_x=h->start_x;lvl->start_z=h->start_z;
+  lvl->goal_x=h->goal_x;lvl->goal_z=h->goal_z;
+  lvl->no_of_bridges=h->no_of_bridges;
+  lvl->bridge=(const SimBridge *)(p+h->bridge_offset);
+  lvl->no_of_switches=h->no_of_switches;
+  lvl->sw=(const SimSwitch *)(p+h->switch_offset);
+  lvl->bridges_start=h->bridges_start;
+  // The same rules level_parse_text holds text levels to
+  size_t cells=(size_t)lvl->width*lvl->depth;
+  for(size_t c=0;c<cells;c++)
+    if(lvl->tile[c]>TILE_HEAVY)
+      return 0;
+  for(int i=0;i<lvl->no_of_tiles;i++)
+  {
+    int x=lvl->tile_order[2*i],z=lvl->tile_order[2*i+1];
+    if(x<0||z<0||x>=lvl->width||z>=lvl->depth)
+      return 0;
+  }
+  for(int i=0;i<lvl->no_of_bridges;i++)
+    for(int k=0;k<2;k++)
+    {
+      int x=lvl->bridge[i].x[k],z=lvl->bridge[i].z[k];
+      if(x<0||z<0||x>=lvl->width||z>=lvl->depth||lvl->tile[x*lvl->depth+z]!=TILE_EMPTY)
+        return 0;
+    }
+  for(int i=0;i<lvl->no_of_switches;i++)
+  {
+    const SimSwitch *sw=&lvl->sw[i];
+    if(sw->bridge<0||sw->bridge>=lvl->no_of_bridges||
+       sw->x<0||sw->z<0||sw->x>=lvl->width||sw->z>=lvl->depth)
+      return 0;
+  }
+  return 1;
+}
+
+int level_file_map(const char *path,MappedLevel *m)
+{
+  memset(m,0,sizeof(*m));
+  int fd=open(path,O_RDONLY);
+  if(fd<0)
+    return 0;
+  struct stat st;
+  void *map=MAP_FAILED;
+  if(fstat(fd,&st)==0&&st.st_size>0)
+    map=mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE|MAP_POPULATE,fd,0);
+  close(fd);
+  if(map==MAP_FAILED)
+    return 0;
+  if(!level_file_view(map,st.st_size,&m->lvl))
+  {
+    munmap(map,st.st_size);
+    return 0;
+  }
+  m->map=map;
+  m->size=st.st_size;
+  return 1;
+}
+
+void level_file_unmap(MappedLevel *m)
+{
+  if(m->map!=NULL)
+    munmap(m->map,m->size);
+  memset(m,0,sizeof(*m));
+}
+
+/* The switch of a round or heavy switch tile, NULL for none */
+static const SimSwitch *switch_at(const Level *lvl,int x,int z)
+{
+  for(int i=0;i<lvl->no_of_switches;i++)
+    if(lvl->sw[i].x==x&&lvl->sw[i].z==z)
+      return &lvl->sw[i];
+  return NULL;
+}
+
+int level_fits_board(const Level *lvl)
+{
+  if(lvl->width>14||lvl->depth>14||lvl->no_of_tiles>lvl->width*lvl->depth)
+    return 0;
+  if((lvl->no_of_bridges!=0&&lvl->no_of_bridges!=2)||lvl->bridges_start!=0)
+    return 0;
+  for(int x=0;x<lvl->width;x++)
+    for(int z=0;z<lvl->depth;z++)
+    {
+      int t=lvl->tile[x*lvl->depth+z];
+      if(t>TILE_HEAVY)
+        return 0;
+      if(t!=TILE_SWITCH&&t!=TILE_HEAVY)
+        continue;
+      const SimSwitch *sw=switch_at(lvl,x,z);
+      if(sw==NULL||sw->bridge!=(t==TILE_SWITCH ? 0 : 1)||sw->bridge>=lvl->no_of_bridges)
+        return 0;
+    }
+  for(int i=0;i<2*lvl->no_of_tiles;i++)
+    if(lvl->tile_order[i]<0||lvl->tile_order[i]>=(i%2 ? lvl->depth : lvl->width))
+      return 0;
+  for(int i=0;i<lvl->no_of_bridges;i++)
+    for(int h=0;h<2;h++)
+    {
+      int x=lvl->bridge[i].x[h],z=lvl->bridge[i].z[h];
+      if(x<0||z<0||x>=lvl->width||z>=lvl->depth||lvl->tile[x*lvl->depth+z]!=TILE_EMPTY)
+        return 0;
+    }
+  for(int i=0;i<lvl->no_of_switches;i++)
+  {
+    const SimSwitch *sw=&lvl->sw[i];
+    int t=lvl->tile[sw->x*lvl->depth+sw->z];
+    if((t!=TILE_SWITCH&&t!=TILE_HEAVY)||sw->bridge!=(t==TILE_SWITCH ? 0 : 1))
+      return 0;
+  }
+  return 1;
+}
@@ -0,0 +1,59 @@
+#ifndef LEVEL_FILE_H
+#define LEVEL_FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sim.h"
+
+/*
+ * Binary level format (.blv). The file is the in-memory layout: a header
+ * followed by 8 byte aligned sections that Level points straight into, so
+ * loading is an mmap plus bounds checks. Little endian.
+ *
+ *   LevelFileHeader
+ *   tile      width*depth uint8, tile[x*depth+z]
+ *   order     no_of_tiles x,z int16 pairs in spawn order
+ *   bridge    no_of_bridges SimBridge
+ *   switch    no_of_switches SimSwitch
+ */
+
+#define LEVEL_FILE_VERSION 1
+
+struct LevelFileHeader {
+  char magic[4];                // "BXLV"
+  uint16_t version;
+  uint16_t header_size;
+  int32_t width,depth;
+  int32_t start_x,start_z;
+  int32_t goal_x,goal_z;
+  int32_t no_of_tiles;
+  int32_t no_of_bridges;
+  int32_t no_of_switches;
+  uint32_t bridges_start;
+  uint32_t tile_offset,order_offset,bridge_offset,switch_offset;
+  uint32_t file_size;
+  uint32_t level_hash;
+};
+
+struct MappedLevel {
+  Level lvl;
+  void *map;
+  size_t size;
+};
+
+size_t level_file_size(const Level *lvl);
+void level_file_encode(const Level *lvl,void *buf);
+int level_file_write(const char *path,const Level *lvl);
+
+/* Point lvl into an encoded level, 0 unless every cell, tile, bridge and switch
+   is on the board; data must be 8 byte aligned and stay valid while lvl is used */
+int level_file_view(const void *data,size_t size,Level *lvl);
+int level_file_map(const char *path,MappedLevel *m);
+void level_file_unmap(MappedLevel *m);
+
+/* Whether a checked level can be played on the game's 14x14 board with its
+   two bridges: a round switch turns bridge 0 and a heavy one bridge 1 */
+int level_fits_board(const Level *lvl);
+
+#endif
@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <vector>
+
+#include "level_pack.h"
+#include "level_file.h"
+
+static size_t align8(size_t n)
+{
+  return (n+7)&~(size_t)7;
+}
+
+static int pad_to(FILE *f,uint64_t *at,uint64_t to)
+{
+  static const char zero[8]={0};
+  int ok=fwrite(zero,1,to-*at,f)==to-*at;
+  *at=to;
+  return ok;
+}
+
+int level_pack_write(const char *path,const Level *const *levels,const char *const *names,
+                     int n,bool hints)
+{
+  FILE *f=fopen(path,"wb");
+  if(f==NULL)
+    return 0;
+  PackHeader h;
+  memset(&h,0,sizeof(h));
+  memcpy(h.magic,"BXPK",4);
+  h.version=LEVEL_PACK_VERSION;
+  h.count=n;
+  h.entry_size=sizeof(PackEntry);
+  std::vector<PackEntry> toc(n);
+  std::vector<char> buf;
+  int ok=fwrite(&h,sizeof(h),1,f)==1;
+  uint64_t at=sizeof(h);
+  for(int i=0;i<n&&ok;i++)
+  {
+    PackEntry *e=&toc[i];
+    memset(e,0,sizeof(*e));
+    if(names!=NULL&&names[i]!=NULL)
+      snprintf(e->name,sizeof(e->name),"%s",names[i]);
+    ok=pad_to(f,&at,align8(at));
+    buf.resize(level_file_size(levels[i]));
+    level_file_encode(levels[i],&buf[0]);
+    e->level_offset=at;
+    e->level_size=buf.size();
+    e->level_hash=level_hash(levels[i]);
+    ok=ok&&fwrite(&buf[0],1,buf.size(),f)==buf.size();
+    at+=buf.size();
+    if(!hints||!ok)
+      continue;
+    HintTable table;
+    hint_table_build(levels[i],&table);
+    HintHeader hh;
+    memcpy(hh.magic,"BXHT",4);
+    hh.version=1;
+    hh.level_hash=table.level_hash;
+    hh.pad=0;
+    hh.count=table.count;
+    ok=pad_to(f,&at,align8(at));
+    e->hint_offset=at;
+    e->hint_size=sizeof(hh)+table.count*sizeof(uint16_t);
+    ok=ok&&fwrite(&hh,sizeof(hh),1,f)==1&&
+       fwrite(table.entry,sizeof(uint16_t),table.count,f)==table.count;
+    at+=e->hint_size;
+    hint_table_free(&table);
+  }
+  ok=ok&&pad_to(f,&at,align8(at));
+  h.toc_offset=at;
+  h.file_size=at+n*sizeof(PackEntry);
+  ok=ok&&fwrite(toc.data(),sizeof(PackEntry),n,f)==(size_t)n;
+  ok=ok&&fseek(f,0,SEEK_SET)==0&&fwrite(&h,sizeof(h),1,f)==1;
+  return fclose(f)==0&&ok;
+}
+
+int level_pack_open(const char *path,LevelPack *pack)
+{
+  memset(pack,0,sizeof(*pack));
+  int fd=open(path,O_RDONLY);
+  if(fd<0)
+    return 0;
+  struct stat st;
+  void *map=MAP_FAILED;
+  if(fstat(fd,&st)==0&&(size_t)st.st_size>=sizeof(PackHeader))
+    map=mmap(NULL,st.st_size,PROT_READ,MAP_SHARED,fd,0);
+  close(fd);
+  if(map==MAP_FAILED)
+    return 0;
+  const PackHeader *h=(const PackHeader *)map;
+  size_t size=st.st_size;
+  if(memcmp(h->magic,"BXPK",4)!=0||h->version!=LEVEL_PACK_VERSION||
+     h->entry_size!=sizeof(PackEntry)||h->file_size>size||h->toc_offset%8!=0||
+     h->toc_offset>size||h->count>(size-h->toc_offset)/sizeof(PackEntry))
+  {
+    munmap(map,size);
+    return 0;
+  }
+  const PackEntry *toc=(const PackEntry *)((const char *)map+h->toc_offset);
+  // Blobs are written 8 byte aligned, which the views into them rely on
+  for(uint32_t i=0;i<h->count;i++)
+    if(toc[i].level_offset>size||toc[i].level_size>size-toc[i].level_offset||
+       toc[i].hint_offset>size||toc[i].hint_size>size-toc[i].hint_offset||
+       toc[i].level_offset%8!=0||toc[i].hint_offset%8!=0)
+    {
+      munmap(map,size);
+      return 0;
+    }
+  // Only the table of contents is touched up front, levels page in on demand
+  madvise(map,size,MADV_RANDOM);
+  pack->map=map;
+  pack->size=size;
+  pack->count=h->count;
+  pack->toc=toc;
+  return 1;
+}
+
+void level_pack_close(LevelPack *pack)
+{
+  if(pack->map!=NULL)
+    munmap(pack->map,pack->size);
+  memset(pack,0,sizeof(*pack));
+}
+
+int level_pack_level(const LevelPack *pack,int level,Level *lvl)
+{
+  if(level<1||level>pack->count)
+    return 0;
+  const PackEntry *e=&pack->toc[level-1];
+  return level_file_view((const char *)pack->map+e->level_offset,e->level_size,lvl)&&
+         level_hash(lvl)==e->level_hash;
+}
+
+int level_pack_hints(const LevelPack *pack,int level,HintTable *table)
+{
+  memset(table,0,sizeof(*table));
+  if(level<1||level>pack->count||pack->toc[level-1].hint_offset==0)
+    return 0;
+  const PackEntry *e=&pack->toc[level-1];
+  return hint_table_view((const char *)pack->map+e->hint_offset,e->hint_size,e->level_hash,table);
+}
+
+static void touch(const LevelPack *pack,uint64_t offset,uint64_t size)
+{
+  long page=sysconf(_SC_PAGESIZE);
+  uint64_t begin=offset&~(uint64_t)(page-1);
+  const volatile char *p=(const volatile char *)pack->map;
+  madvise((char *)pack->map+begin,offset+size-begin,MADV_WILLNEED);
+  for(uint64_t i=begin;i<offset+size;i+=page)
+    (void)p[i];
+}
+
+void level_pack_prefetch(const LevelPack *pack,int level)
+{
+  if(level<1||level>pack->count)
+    return;
+  const PackEntry *e=&pack->toc[level-1];
+  touch(pack,e->level_offset,e->level_size);
+  if(e->hint_offset!=0)
+    touch(pack,e->hint_offset,e->hint_size);
+}
@@ -0,0 +1,63 @@
+#ifndef LEVEL_PACK_H
+#define LEVEL_PACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sim.h"
+#include "hint.h"
+
+/*
+ * Level pack (.bxp): many levels in one memory mapped file. Little endian,
+ * every blob 8 byte aligned.
+ *
+ *   PackHeader
+ *   blobs     per level a .blv image, then optionally its hint table
+ *             (HintHeader and entries, as in a .hint file)
+ *   toc       count PackEntry, at toc_offset
+ *
+ * Levels are numbered from 1 like LEVEL in the game.
+ */
+
+#define LEVEL_PACK_VERSION 1
+
+struct PackHeader {
+  char magic[4];                // "BXPK"
+  uint32_t version;
+  uint32_t count;
+  uint32_t entry_size;
+  uint64_t toc_offset;
+  uint64_t file_size;
+};
+
+struct PackEntry {
+  uint64_t level_offset;
+  uint64_t hint_offset;         // 0 when the pack has no hints for it
+  uint32_t level_size;
+  uint32_t level_hash;
+  uint64_t hint_size;
+  char name[32];
+};
+
+struct LevelPack {
+  void *map;
+  size_t size;
+  int count;
+  const PackEntry *toc;
+};
+
+/* Write levels[0..n) with their names (may be NULL), building hint tables if asked */
+int level_pack_write(const char *path,const Level *const *levels,const char *const *names,
+                     int n,bool hints);
+
+int level_pack_open(const char *path,LevelPack *pack);
+void level_pack_close(LevelPack *pack);
+
+/* Zero copy views into the pack, valid until it is closed */
+int level_pack_level(const LevelPack *pack,int level,Level *lvl);
+int level_pack_hints(const LevelPack *pack,int level,HintTable *table);
+
+/* Fault in a level's pages so the views above do not stall on disk */
+void level_pack_prefetch(const LevelPack *pack,int level);
+
+#endif
@@ -0,0 +1,244 @@
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "level_text.h"
+
+static const char tile_char[5]={'.','#','=','r','b'};
+
+void level_write_text(FILE *f,const Level *lvl)
+{
+  fprintf(f,"size %d %d\n",lvl->width,lvl->depth);
+  for(int i=0;i<lvl->no_of_bridges;i++)
+  {
+    const SimBridge *b=&lvl->bridge[i];
+    fprintf(f,"bridge %d %d %d %d%s\n",b->x[0],b->z[0],b->x[1],b->z[1],
+            lvl->bridges_start>>i&1 ? " closed" : "");
+  }
+  for(int i=0;i<lvl->no_of_switches;i++)
+    fprintf(f,"switch %d %d %d\n",lvl->sw[i].x,lvl->sw[i].z,lvl->sw[i].bridge);
+  fprintf(f,"grid\n");
+  for(int z=0;z<lvl->depth;z++)
+  {
+    for(int x=0;x<lvl->width;x++)
+    {
+      char c=tile_char[lvl->tile[x*lvl->depth+z]];
+      if(x==lvl->start_x&&z==lvl->start_z) c='S';
+      if(x==lvl->goal_x&&z==lvl->goal_z) c='G';
+      fputc(c,f);
+    }
+    fputc('\n',f);
+  }
+}
+
+static int fail(LevelParse *p,const char *msg)
+{
+  snprintf(p->error,sizeof(p->error),"line %d: %s",p->line,msg);
+  return 0;
+}
+
+static void skip_blanks(const char **s,const char *end)
+{
+  while(*s<end&&(**s==' '||**s=='\t'))
+    (*s)++;
+}
+
+static int read_int(const char **s,const char *end,int *v)
+{
+  skip_blanks(s,end);
+  int sign=1,n=0,digits=0;
+  if(*s<end&&**s=='-')
+  {
+    sign=-1;
+    (*s)++;
+  }
+  while(*s<end&&**s>='0'&&**s<='9'&&digits<9)
+  {
+    n=n*10+(**s-'0');
+    (*s)++;
+    digits++;
+  }
+  *v=sign*n;
+  return digits>0;
+}
+
+static int keyword(const char **s,const char *end,const char *word)
+{
+  size_t n=strlen(word);
+  if((size_t)(end-*s)<n||memcmp(*s,word,n)!=0)
+    return 0;
+  if(*s+n<end&&(*s)[n]!=' '&&(*s)[n]!='\t')
+    return 0;
+  *s+=n;
+  return 1;
+}
+
+static int at_end(const char *s,const char *end)
+{
+  skip_blanks(&s,end);
+  return s==end;
+}
+
+static bool inside(const Level *lvl,int x,int z)
+{
+  return x>=0&&z>=0&&x<lvl->width&&z<lvl->depth;
+}
+
+int level_parse_text(const char *text,size_t len,LevelParse *p,Level *lvl)
+{
+  const char *s=text,*end=text+len;
+  int row=-1,starts=0,goals=0;
+  memset(lvl,0,sizeof(*lvl));
+  lvl->tile=p->tile;
+  lvl->tile_order=p->order;
+  lvl->bridge=p->bridge;
+  lvl->sw=p->sw;
+  p->line=0;
+  p->error[0]=0;
+  while(s<end)
+  {
+    const char *eol=(const char *)memchr(s,'\n',end-s);
+    if(eol==NULL)
+      eol=end;
+    const char *next=eol<end ? eol+1 : end;
+    if(eol>s&&eol[-1]=='\r')
+      eol--;
+    p->line++;
+    if(row<0)
+    {
+      // Header: blank lines and # comments are allowed here only
+      skip_blanks(&s,eol);
+      if(s==eol||*s=='#')
+      {
+        s=next;
+        continue;
+      }
+      int v[4];
+      if(keyword(&s,eol,"size"))
+      {
+        if(!read_int(&s,eol,&v[0])||!read_int(&s,eol,&v[1])||!at_end(s,eol))
+          return fail(p,"expected size WIDTH DEPTH");
+        if(v[0]<1||v[1]<1||v[0]>32767||v[1]>32767||(size_t)v[0]*v[1]>p->capacity)
+          return fail(p,"board too large");
+        lvl->width=v[0];lvl->depth=v[1];
+        memset(p->tile,0,(size_t)v[0]*v[1]);
+      }
+      else if(keyword(&s,eol,"bridge"))
+      {
+        if(lvl->no_of_bridges==MAX_BRIDGES)
+          return fail(p,"too many bridges");
+        for(int k=0;k<4;k++)
+          if(!read_int(&s,eol,&v[k]))
+            return fail(p,"expected bridge X0 Z0 X1 Z1 [closed]");
+        skip_blanks(&s,eol);
+        if(keyword(&s,eol,"closed"))
+          lvl->bridges_start|=1u<<lvl->no_of_bridges;
+        if(!at_end(s,eol))
+          return fail(p,"expected bridge X0 Z0 X1 Z1 [closed]");
+        SimBridge b={{(int16_t)v[0],(int16_t)v[2]},{(int16_t)v[1],(int16_t)v[3]}};
+        p->bridge[lvl->no_of_bridges++]=b;
+      }
+      else if(keyword(&s,eol,"switch"))
+      {
+        if(lvl->no_of_switches==MAX_SWITCHES)
+          return fail(p,"too many switches");
+        if(!read_int(&s,eol,&v[0])||!read_int(&s,eol,&v[1])||!read_int(&s,eol,&v[2])||!at_end(s,eol))
+          return fail(p,"expected switch X Z BRIDGE");
+        SimSwitch sw={(int16_t)v[0],(int16_t)v[1],(int16_t)v[2],0};
+        p->sw[lvl->no_of_switches++]=sw;
+      }
+      else if(keyword(&s,eol,"grid")&&at_end(s,eol))
+      {
+        if(lvl->width==0)
+          return fail(p,"grid before size");
+        row=0;
+      }
+      else
+        return fail(p,"unknown line");
+      s=next;
+      continue;
+    }
+
+    if(row==lvl->depth)
+    {
+      if(!at_end(s,eol))
+        return fail(p,"more rows than the size says");
+      s=next;
+      continue;
+    }
+    if(eol-s!=lvl->width)
+      return fail(p,"row length differs from the width");
+    uint8_t *t=p->tile+row;
+    for(int x=0;x<lvl->width;x++,t+=lvl->depth)
+    {
+      switch(s[x])
+      {
+        case '.': break;
+        case '#': *t=TILE_NORMAL; break;
+        case '=': *t=TILE_FRAGILE; break;
+        case 'r': *t=TILE_SWITCH; break;
+        case 'b': *t=TILE_HEAVY; break;
+        case 'S': *t=TILE_NORMAL; lvl->start_x=x; lvl->start_z=row; starts++; break;
+        case 'G': *t=TILE_NORMAL; lvl->goal_x=x; lvl->goal_z=row; goals++; break;
+        default: return fail(p,"unknown tile character");
+      }
+    }
+    row++;
+    s=next;
+  }
+
+  if(row<lvl->depth)
+    return fail(p,row<0 ? "no grid" : "fewer rows than the size says");
+  if(starts!=1||goals!=1)
+    return fail(p,"the grid needs exactly one S and one G");
+  if(lvl->start_x==lvl->goal_x&&lvl->start_z==lvl->goal_z)
+    return fail(p,"start and goal on the same cell");
+  for(int i=0;i<lvl->no_of_bridges;i++)
+    for(int k=0;k<2;k++)
+    {
+      int x=p->bridge[i].x[k],z=p->bridge[i].z[k];
+      if(!inside(lvl,x,z)||p->tile[x*lvl->depth+z]!=TILE_EMPTY)
+        return fail(p,"bridge cells must be empty cells on the board");
+    }
+  for(int i=0;i<lvl->no_of_switches;i++)
+  {
+    const SimSwitch *sw=&p->sw[i];
+    if(!inside(lvl,sw->x,sw->z))
+      return fail(p,"switch off the board");
+    int t=p->tile[sw->x*lvl->depth+sw->z];
+    if(t!=TILE_SWITCH&&t!=TILE_HEAVY)
+      return fail(p,"switch not on an r or b tile");
+    if(sw->bridge<0||sw->bridge>=lvl->no_of_bridges)
+      return fail(p,"switch refers to a missing bridge");
+  }
+  int unreached;
+  lvl->no_of_tiles=level_spawn_order(lvl,p->tile,p->order,&unreached);
+  if(unreached>=0)
+  {
+    snprintf(p->error,sizeof(p->error),"switch at %d %d cannot be reached",
+             p->sw[unreached].x,p->sw[unreached].z);
+    return 0;
+  }
+  return 1;
+}
+
+int level_read_text(const char *path,LevelParse *p,Level *lvl)
+{
+  p->line=0;
+  snprintf(p->error,sizeof(p->error),"cannot read %s",path);
+  int fd=open(path,O_RDONLY);
+  if(fd<0)
+    return 0;
+  struct stat st;
+  void *map=MAP_FAILED;
+  if(fstat(fd,&st)==0&&st.st_size>0)
+    map=mmap(NULL,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+  close(fd);
+  if(map==MAP_FAILED)
+    return 0;
+  int ok=level_parse_text((const char *)map,st.st_size,p,lvl);
+  munmap(map,st.st_size);
+  return ok;
+}
@@ -0,0 +1,45 @@
+#ifndef LEVEL_TEXT_H
+#define LEVEL_TEXT_H
+
+#include <stdio.h>
+
+#include "sim.h"
+
+/*
+ * ASCII level format. Header lines, then "grid" and one line per z row
+ * with one character per x cell:
+ *
+ *   size 14 14
+ *   bridge 6 4 7 4          two cells, append "closed" if closed at start
+ *   switch 2 4 0            cell and bridge number
+ *   grid
+ *   ..###=r..S..G
+ *
+ *   .  empty (also bridge cells)   #  normal   =  fragile
+ *   r  switch (lying along x)      b  heavy switch (standing only)
+ *   S  start                       G  goal
+ */
+
+void level_write_text(FILE *f,const Level *lvl);
+
+/*
+ * Single pass parser. It never allocates: the grid and the derived spawn
+ * order go to the caller's buffers, which must hold capacity cells (tile)
+ * and 2*capacity entries (order). The result is checked (bounds, bridges
+ * on empty cells, every switch reachable) and the spawn order derived.
+ * On failure it returns 0 and leaves the line and message in p.
+ */
+struct LevelParse {
+  uint8_t *tile;
+  int16_t *order;
+  size_t capacity;
+  SimBridge bridge[MAX_BRIDGES];
+  SimSwitch sw[MAX_SWITCHES];
+  int line;
+  char error[128];
+};
+
+int level_parse_text(const char *text,size_t len,LevelParse *p,Level *lvl);
+int level_read_text(const char *path,LevelParse *p,Level *lvl);
+
+#endif
@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <new>
+
+#include "obs_ring.h"
+
+using namespace std;
+
+static_assert(ATOMIC_LLONG_LOCK_FREE==2,"the ring needs lock free 64 bit atomics");
+
+#define HEADER_SIZE 64
+
+static size_t align64(size_t n)
+{
+  return (n+63)&~(size_t)63;
+}
+
+static atomic<uint64_t> *slot_seq(const ObsRing *r,uint64_t n)
+{
+  return (atomic<uint64_t> *)((char *)r->h+HEADER_SIZE+(n%r->h->slot_count)*r->h->slot_size);
+}
+
+static ObsFrame *slot_frame(const ObsRing *r,uint64_t n)
+{
+  return (ObsFrame *)(slot_seq(r,n)+1);
+}
+
+int obs_ring_create(ObsRing *r,const char *name,int slots,int max_cells)
+{
+  memset(r,0,sizeof(*r));
+  if(slots<1||max_cells<0)
+    return 0;
+  size_t slot_size=align64(sizeof(atomic<uint64_t>)+sizeof(ObsFrame)+max_cells);
+  size_t size=HEADER_SIZE+slots*slot_size;
+  int fd=shm_open(name,O_RDWR|O_CREAT|O_TRUNC,0600);
+  if(fd<0)
+    return 0;
+  void *map=MAP_FAILED;
+  if(ftruncate(fd,size)==0)
+    map=mmap(NULL,size,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+  close(fd);
+  if(map==MAP_FAILED)
+  {
+    shm_unlink(name);
+    return 0;
+  }
+  // The object is zero filled, so every slot starts out as never written
+  r->h=new(map) RingHeader;
+  r->h->version=OBS_RING_VERSION;
+  r->h->slot_count=slots;
+  r->h->slot_size=slot_size;
+  r->h->max_cells=max_cells;
+  r->h->head.store(0,memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  memcpy(r->h->magic,"BXOR",4);
+  r->size=size;
+  r->owner=true;
+  snprintf(r->name,sizeof(r->name),"%s",name);
+  return 1;
+}
+
+ObsFrame *obs_ring_begin(ObsRing *r,uint8_t **tile)
+{
+  uint64_t n=r->h->head.load(memory_order_relaxed);
+  slot_seq(r,n)->store(2*n+1,memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  ObsFrame *f=slot_frame(r,n);
+  *tile=(uint8_t *)(f+1);
+  return f;
+}
+
+void obs_ring_publish(ObsRing *r)
+{
+  uint64_t n=r->h->head.load(memory_order_relaxed);
+  ObsFrame *f=slot_frame(r,n);
+  if((uint64_t)f->width*f->depth>r->h->max_cells)
+    f->width=f->depth=0;
+  f->check=obs_frame_check(f,(const uint8_t *)(f+1));
+  slot_seq(r,n)->store(2*n+2,memory_order_release);
+  r->h->head.store(n+1,memory_order_release);
+}
+
+int obs_ring_open(ObsRing *r,const char *name)
+{
+  memset(r,0,sizeof(*r));
+  int fd=shm_open(name,O_RDONLY,0);
+  if(fd<0)
+    return 0;
+  struct stat st;
+  void *map=MAP_FAILED;
+  if(fstat(fd,&st)==0&&(size_t)st.st_size>=HEADER_SIZE)
+    map=mmap(NULL,st.st_size,PROT_READ,MAP_SHARED,fd,0);
+  close(fd);
+  if(map==MAP_FAILED)
+    return 0;
+  const RingHeader *h=(const RingHeader *)map;
+  size_t size=st.st_size;
+  if(memcmp(h->magic,"BXOR",4)!=0||h->version!=OBS_RING_VERSION||h->slot_count==0||
+     h->slot_size<align64(sizeof(atomic<uint64_t>)+sizeof(ObsFrame)+h->max_cells)||
+     (size-HEADER_SIZE)/h->slot_size<h->slot_count)
+  {
+    munmap(map,size);
+    return 0;
+  }
+  r->h=(RingHeader *)map;
+  r->size=size;
+  snprintf(r->name,sizeof(r->name),"%s",name);
+  return 1;
+}
+
+uint64_t obs_ring_head(const ObsRing *r)
+{
+  return r->h->head.load(memory_order_acquire);
+}
+
+int obs_ring_read(const ObsRing *r,uint64_t n,ObsFrame *f,uint8_t *tile)
+{
+  const atomic<uint64_t> *seq=slot_seq(r,n);
+  uint64_t before=seq->load(memory_order_acquire);
+  if(before<2*n+2)
+    return 0;
+  if(before>2*n+2)
+    return -1;
+  const ObsFrame *src=slot_frame(r,n);
+  memcpy(f,src,sizeof(*f));
+  // A torn size must not run past the slot, the sequence check rejects it after
+  size_t cells=(uint64_t)f->width*f->depth;
+  memcpy(tile,src+1,cells<=r->h->max_cells ? cells : r->h->max_cells);
+  atomic_thread_fence(memory_order_acquire);
+  return seq->load(memory_order_relaxed)==before ? 1 : -1;
+}
+
+uint32_t obs_frame_check(const ObsFrame *f,const uint8_t *tile)
+{
+  uint32_t h=2166136261u;
+  const uint8_t *p=(const uint8_t *)f;
+  for(size_t i=0;i<offsetof(ObsFrame,check);i++)
+    h=(h^p[i])*16777619u;
+  for(size_t i=0;i<(size_t)f->width*f->depth;i++)
+    h=(h^tile[i])*16777619u;
+  return h;
+}
+
+void obs_ring_close(ObsRing *r)
+{
+  if(r->h!=NULL)
+    munmap(r->h,r->size);
+  if(r->owner)
+    shm_unlink(r->name);
+  memset(r,0,sizeof(*r));
+}
@@ -0,0 +1,74 @@
+#ifndef OBS_RING_H
+#define OBS_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+#include "sim.h"
+
+/*
+ * Observation ring: the game (or a headless run) publishes its state every
+ * step into a POSIX shared memory object that other processes map and read
+ * without locks or copies through a pipe. One writer, any number of readers.
+ *
+ *   RingHeader
+ *   slots     slot_count slots of slot_size bytes, 64 byte aligned:
+ *             the slot's sequence, an ObsFrame, then width*depth tiles
+ *
+ * Frame n goes to slot n % slot_count. Its sequence is odd while the writer
+ * fills it and 2n+2 once it is done, so a reader that sees the same even
+ * value before and after copying got the whole of frame n; a newer value
+ * means the writer lapped it.
+ */
+
+#define OBS_RING_VERSION 1
+
+struct RingHeader {
+  char magic[4];                // "BXOR"
+  uint32_t version;
+  uint32_t slot_count;
+  uint32_t slot_size;
+  uint32_t max_cells;           // tile bytes a slot has room for
+  uint32_t pad;
+  std::atomic<uint64_t> head;   // frames published so far
+};
+
+struct ObsFrame {
+  uint64_t tick;
+  int32_t level;
+  int32_t width,depth;          // of tile[], 0 if the level is too big for the ring
+  int32_t x,z,orient;           // the block as a SimState
+  uint32_t bridges;
+  int32_t cube;                 // orientation of the block out of 24, -1 if unknown
+  int32_t fall_status;          // Block.fall_status, or a Status after a headless roll
+  int32_t moving;               // input is held while the block or a bridge moves
+  int32_t no_of_bridges;
+  float bridge_angle[MAX_BRIDGES];  // 0 walkable, 90 open
+  uint32_t check;               // FNV-1a of the frame above and its tiles
+};
+
+struct ObsRing {
+  RingHeader *h;
+  size_t size;
+  bool owner;                   // the writer unlinks it on close
+  char name[64];
+};
+
+/* Writer side. name is a POSIX shm name, "/blox" */
+int obs_ring_create(ObsRing *r,const char *name,int slots,int max_cells);
+/* The frame to fill next and its tiles, then publish it */
+ObsFrame *obs_ring_begin(ObsRing *r,uint8_t **tile);
+void obs_ring_publish(ObsRing *r);
+
+/* Reader side */
+int obs_ring_open(ObsRing *r,const char *name);
+uint64_t obs_ring_head(const ObsRing *r);
+/* Copy frame n and its tiles (max_cells bytes of room). Returns 1, 0 if it
+   is not out yet, -1 if it was overwritten */
+int obs_ring_read(const ObsRing *r,uint64_t n,ObsFrame *f,uint8_t *tile);
+uint32_t obs_frame_check(const ObsFrame *f,const uint8_t *tile);
+
+void obs_ring_close(ObsRing *r);
+
+#endif
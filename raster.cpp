@@ -0,0 +1,64 @@
+#include <string.h>
+
+#include "raster.h"
+
+void raster_init(Raster *r,const Level *lvl)
+{
+  int d=lvl->depth;
+  r->width=lvl->width;
+  r->depth=d;
+  r->cells=(size_t)lvl->width*d;
+  r->size=RASTER_PLANES*r->cells;
+  r->base.assign(r->size,0);
+  uint8_t *plane=&r->base[0];
+  for(size_t c=0;c<r->cells;c++)
+  {
+    int t=lvl->tile[c];
+    plane[PLANE_FLOOR*r->cells+c]=t!=TILE_EMPTY;
+    plane[PLANE_FRAGILE*r->cells+c]=t==TILE_FRAGILE;
+    plane[PLANE_SWITCH*r->cells+c]=t==TILE_SWITCH ? 1 : t==TILE_HEAVY ? 2 : 0;
+  }
+  r->bridge_cell.resize(2*lvl->no_of_bridges);
+  for(int i=0;i<lvl->no_of_bridges;i++)
+    for(int k=0;k<2;k++)
+    {
+      int c=lvl->bridge[i].x[k]*d+lvl->bridge[i].z[k];
+      r->bridge_cell[2*i+k]=c;
+      plane[PLANE_BRIDGE*r->cells+c]=1;
+    }
+  plane[PLANE_GOAL*r->cells+lvl->goal_x*d+lvl->goal_z]=1;
+}
+
+/* The block and the closed bridges on a copy of the base image */
+static inline void patch(const Raster *r,int c,int orient,uint32_t bridges,uint8_t *obs)
+{
+  uint8_t *floor=obs+PLANE_FLOOR*r->cells,*block=obs+PLANE_BLOCK*r->cells;
+  for(int i=0;bridges!=0;i++,bridges>>=1)
+    if(bridges&1)
+      floor[r->bridge_cell[2*i]]=floor[r->bridge_cell[2*i+1]]=1;
+  if(orient==STANDING)
+    block[c]=2;
+  else
+  {
+    block[c]=1;
+    block[c+(orient==LYING_X ? r->depth : 1)]=1;
+  }
+}
+
+void raster_draw(const Raster *r,const SimState *s,uint8_t *obs)
+{
+  memcpy(obs,&r->base[0],r->size);
+  patch(r,s->x*r->depth+s->z,s->orient,s->bridges,obs);
+}
+
+void raster_env(const Raster *r,const EnvBatch *b,uint8_t *obs)
+{
+  // Games in a batch are always on the board, whose cells map one to one
+  for(int i=0;i<b->n;i++,obs+=r->size)
+  {
+    int c=b->cell[i]-ENV_PAD*b->pd-ENV_PAD;
+    int x=c/b->pd,z=c-x*b->pd;
+    memcpy(obs,&r->base[0],r->size);
+    patch(r,x*r->depth+z,b->orient[i],b->bridges[i],obs);
+  }
+}
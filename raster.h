@@ -0,0 +1,41 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "sim.h"
+#include "env.h"
+
+/*
+ * Top-down observation of a game as uint8 planes of width*depth cells,
+ * plane[x*depth+z] like Level.tile, drawn on the CPU with no GL. The tiles
+ * that never change are drawn once per level; an observation is a copy of
+ * that image with the closed bridges and the block patched in.
+ */
+
+enum RasterPlane {
+  PLANE_FLOOR,                  // 1 where the block can rest, closed bridges included
+  PLANE_FRAGILE,                // 1 on fragile tiles
+  PLANE_SWITCH,                 // 1 on red switches, 2 on blue (standing only) ones
+  PLANE_BRIDGE,                 // 1 on bridge cells, open or closed
+  PLANE_GOAL,                   // 1 on the goal
+  PLANE_BLOCK,                  // 2 under a standing block, 1 under each half of a lying one
+  RASTER_PLANES
+};
+
+struct Raster {
+  int width,depth;
+  size_t cells;                 // width*depth, the size of a plane
+  size_t size;                  // of one observation, RASTER_PLANES planes
+  std::vector<uint8_t> base;    // the observation with every bridge open and no block
+  std::vector<int32_t> bridge_cell;   // 2 per bridge
+};
+
+void raster_init(Raster *r,const Level *lvl);
+/* One observation of s into obs (r->size bytes) */
+void raster_draw(const Raster *r,const SimState *s,uint8_t *obs);
+/* Every game of the batch, obs holds b->n observations back to back */
+void raster_env(const Raster *r,const EnvBatch *b,uint8_t *obs);
+
+#endif
@@ -0,0 +1,176 @@
+#include <string.h>
+
+#include "replay.h"
+
+static int put_varint(ReplayWriter *w,uint64_t v)
+{
+  uint8_t buf[10];
+  int n=0;
+  do
+  {
+    buf[n]=v&127;
+    v>>=7;
+    if(v!=0)
+      buf[n]|=128;
+    n++;
+  }
+  while(v!=0);
+  w->bytes+=n;
+  return fwrite(buf,1,n,w->f)==(size_t)n;
+}
+
+static int put(ReplayWriter *w,const void *data,size_t n)
+{
+  w->bytes+=n;
+  return fwrite(data,1,n,w->f)==n;
+}
+
+int replay_create(ReplayWriter *w,const char *path,int first_level,uint32_t level_hash,
+                  int queue_depth)
+{
+  memset(w,0,sizeof(*w));
+  w->f=fopen(path,"wb");
+  if(w->f==NULL)
+    return 0;
+  ReplayHeader h;
+  memcpy(h.magic,"BXRP",4);
+  h.version=REPLAY_VERSION;
+  h.tick_hz=REPLAY_TICK_HZ;
+  h.first_level=first_level;
+  h.level_hash=level_hash;
+  h.queue_depth=queue_depth;
+  if(!put(w,&h,sizeof(h)))
+  {
+    fclose(w->f);
+    w->f=NULL;
+    return 0;
+  }
+  return 1;
+}
+
+int replay_write(ReplayWriter *w,const ReplayEvent *e)
+{
+  if(w->f==NULL)
+    return 0;
+  uint64_t delta=e->tick-w->tick;
+  int ok;
+  w->tick=e->tick;
+  w->events++;
+  if(e->type==REPLAY_ROLL)
+    return put_varint(w,(delta+1)<<2|(e->move&3));
+  uint8_t type=e->type-1;
+  ok=put(w,&type,1)&&put_varint(w,delta);
+  switch(e->type)
+  {
+    case REPLAY_KEY:
+      ok=ok&&put_varint(w,e->code)&&put(w,&e->action,1);
+      break;
+    case REPLAY_MOUSE:
+      ok=ok&&put(w,&e->button,1)&&put(w,&e->action,1)&&put(w,&e->x,4)&&put(w,&e->y,4);
+      break;
+    case REPLAY_CHAR:
+      ok=ok&&put_varint(w,e->code);
+      break;
+  }
+  return ok;
+}
+
+int replay_finish(ReplayWriter *w,uint64_t tick)
+{
+  if(w->f==NULL)
+    return 0;
+  ReplayEvent e;
+  memset(&e,0,sizeof(e));
+  e.type=REPLAY_END;
+  e.tick=tick;
+  int ok=replay_write(w,&e);
+  ok=fclose(w->f)==0&&ok;
+  w->f=NULL;
+  return ok;
+}
+
+struct Reader {
+  const uint8_t *p,*end;
+};
+
+static int get_varint(Reader *r,uint64_t *v)
+{
+  *v=0;
+  for(int shift=0;shift<64&&r->p<r->end;shift+=7)
+  {
+    uint8_t b=*r->p++;
+    *v|=(uint64_t)(b&127)<<shift;
+    if(!(b&128))
+      return 1;
+  }
+  return 0;
+}
+
+static int get(Reader *r,void *data,size_t n)
+{
+  if((size_t)(r->end-r->p)<n)
+    return 0;
+  memcpy(data,r->p,n);
+  r->p+=n;
+  return 1;
+}
+
+int replay_load(const char *path,Replay *replay)
+{
+  replay->event.clear();
+  FILE *f=fopen(path,"rb");
+  if(f==NULL)
+    return 0;
+  std::vector<uint8_t> buf;
+  uint8_t chunk[65536];
+  size_t n;
+  while((n=fread(chunk,1,sizeof(chunk),f))>0)
+    buf.insert(buf.end(),chunk,chunk+n);
+  fclose(f);
+  Reader r={buf.data(),buf.data()+buf.size()};
+  if(!get(&r,&replay->header,sizeof(ReplayHeader))||memcmp(replay->header.magic,"BXRP",4)!=0||
+     replay->header.version!=REPLAY_VERSION||replay->header.tick_hz!=REPLAY_TICK_HZ)
+    return 0;
+  uint64_t tick=0;
+  while(r.p<r.end)
+  {
+    ReplayEvent e;
+    uint64_t v;
+    memset(&e,0,sizeof(e));
+    if(*r.p>=4)
+    {
+      if(!get_varint(&r,&v)||v>>2==0)
+        return 0;
+      e.type=REPLAY_ROLL;
+      e.move=v&3;
+      e.tick=tick+=(v>>2)-1;
+      replay->event.push_back(e);
+      continue;
+    }
+    e.type=*r.p++ +1;
+    if(!get_varint(&r,&v))
+      return 0;
+    e.tick=tick+=v;
+    int ok=1;
+    switch(e.type)
+    {
+      case REPLAY_KEY:
+        ok=get_varint(&r,&v)&&get(&r,&e.action,1);
+        e.code=v;
+        break;
+      case REPLAY_MOUSE:
+        ok=get(&r,&e.button,1)&&get(&r,&e.action,1)&&get(&r,&e.x,4)&&get(&r,&e.y,4);
+        break;
+      case REPLAY_CHAR:
+        ok=get_varint(&r,&v);
+        e.code=v;
+        break;
+    }
+    if(!ok)
+      return 0;
+    replay->event.push_back(e);
+    if(e.type==REPLAY_END)
+      return 1;
+  }
+  return 0;
+}
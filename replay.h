@@ -0,0 +1,79 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+/*
+ * Input log of a session (.bxr), enough to play it again exactly. The game
+ * steps in fixed ticks of 1/REPLAY_TICK_HZ s and every event is stamped
+ * with the tick it was handled in. Little endian:
+ *
+ *   ReplayHeader
+ *   events    until the REPLAY_END one
+ *
+ * A roll is one varint, ((tick delta + 1) << 2) | Move, so 2 bits plus the
+ * delta. Any other event starts with a byte below 4, its type - 1, then the
+ * tick delta as a varint and its payload:
+ *
+ *   REPLAY_KEY    varint GLFW key, byte action
+ *   REPLAY_MOUSE  byte button, byte action, float x, float y
+ *   REPLAY_CHAR   varint codepoint
+ *   REPLAY_END    nothing, its tick is where the session stopped
+ */
+
+#define REPLAY_VERSION 1
+#define REPLAY_TICK_HZ 120
+
+/* How long the game animates things for. A replay only plays the same with
+   the same timings, so changing one needs a new REPLAY_VERSION */
+#define ROLL_SECONDS 0.45
+#define LAND_SECONDS 0.5        // the block dropping in after the intro
+#define SPAWN_SECONDS 0.1       // per tile of the intro
+#define BRIDGE_SPEED 100        // degrees per second
+#define FALL_DEPTH 3.5          // falls end at y=-FALL_DEPTH
+#define FALL_SPEED 10           // off an edge
+#define SINK_SPEED 5            // through a broken tile or into the goal
+
+enum ReplayType { REPLAY_ROLL, REPLAY_KEY, REPLAY_MOUSE, REPLAY_CHAR, REPLAY_END };
+
+struct ReplayHeader {
+  char magic[4];                // "BXRP"
+  uint32_t version;
+  uint32_t tick_hz;
+  uint32_t first_level;         // LEVEL the session started at
+  uint32_t level_hash;          // of that level
+  uint32_t queue_depth;         // rolls past it were dropped, so it must match
+};
+
+struct ReplayEvent {
+  uint64_t tick;
+  uint8_t type;
+  uint8_t move;                 // REPLAY_ROLL
+  uint8_t button;               // REPLAY_MOUSE
+  uint8_t action;               // REPLAY_KEY and REPLAY_MOUSE
+  uint32_t code;                // GLFW key, or codepoint for REPLAY_CHAR
+  float x,y;                    // cursor in window pixels for REPLAY_MOUSE
+};
+
+struct ReplayWriter {
+  FILE *f;
+  uint64_t tick;                // of the last event written
+  uint64_t events,bytes;
+};
+
+int replay_create(ReplayWriter *w,const char *path,int first_level,uint32_t level_hash,
+                  int queue_depth);
+int replay_write(ReplayWriter *w,const ReplayEvent *e);
+/* Write the REPLAY_END event at tick and close */
+int replay_finish(ReplayWriter *w,uint64_t tick);
+
+struct Replay {
+  ReplayHeader header;
+  std::vector<ReplayEvent> event;   // ends with the REPLAY_END event
+};
+
+int replay_load(const char *path,Replay *replay);
+
+#endif
@@ -0,0 +1,236 @@
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "replay_run.h"
+#include "input_queue.h"
+
+/* GLFW_KEY_ESCAPE and GLFW_PRESS, which quit the game */
+#define KEY_ESCAPE 256
+#define KEY_PRESS 1
+
+/* What the block is doing, as the game's hang/fall_status/cuboid say it */
+enum Phase { PH_INTRO, PH_LANDING, PH_ROLLING, PH_BRIDGE, PH_FALLING, PH_FREE, PH_STOPPED };
+
+struct Run {
+  const Level *const *levels;
+  int count;
+  int level;
+  const Level *lvl;
+  SimState state;
+  int phase;
+  uint64_t phase_end;           // tick whose timeline update ends the phase
+  int move;                     // of the roll in flight
+  int status;                   // of the fall in flight
+  InputQueue queue;
+  bool pushed;                  // rolls came in at tick pushed_at
+  uint64_t pushed_at;
+  ReplayObserver observe;
+  void *arg;
+  ReplayResult *result;
+};
+
+static double tick_time(uint64_t tick)
+{
+  return tick*(1.0/REPLAY_TICK_HZ);
+}
+
+/* First tick at which tl_update sees a track added at tick start as done,
+   with the very same arithmetic */
+static uint64_t end_tick(uint64_t start,double duration)
+{
+  double rate=duration>0 ? 1/duration : 0;
+  double from=tick_time(start);
+  uint64_t k=start+1;
+  if(rate>0)
+  {
+    double guess=floor(duration*REPLAY_TICK_HZ);
+    if(guess>1)
+      k=start+(uint64_t)guess-1;
+    while((tick_time(k)-from)*rate<1)
+      k++;
+  }
+  return k;
+}
+
+static void level_init(Run *run,uint64_t tick)
+{
+  iq_clear(&run->queue);
+  if(run->level<1||run->level>run->count)
+  {
+    run->phase=PH_STOPPED;
+    run->result->outcome=RUN_BAD_LEVEL;
+    return;
+  }
+  run->lvl=run->levels[run->level-1];
+  sim_reset(run->lvl,&run->state);
+  run->phase=PH_INTRO;
+  run->phase_end=end_tick(tick,SPAWN_SECONDS*run->lvl->no_of_tiles);
+  if(run->observe!=NULL)
+    run->observe(run->arg,run->level,run->lvl,&run->state,ST_OK,tick);
+}
+
+/* The phase that ends at tick is over, as the game's callback would have it */
+static void phase_done(Run *run,uint64_t tick)
+{
+  switch(run->phase)
+  {
+    case PH_INTRO:
+    {
+      // Land, with the bridges opening meanwhile; free once both are done
+      uint64_t land=end_tick(tick,LAND_SECONDS);
+      run->phase=PH_LANDING;
+      run->phase_end=land;
+      if(run->lvl->no_of_bridges>0)
+      {
+        uint64_t open=end_tick(tick,90.0/BRIDGE_SPEED);
+        if(open>land)
+          run->phase_end=open;
+      }
+      break;
+    }
+    case PH_LANDING:
+    case PH_BRIDGE:
+      run->phase=PH_FREE;
+      break;
+    case PH_ROLLING:
+    {
+      uint32_t bridges=run->state.bridges;
+      run->status=sim_step(run->lvl,&run->state,run->move);
+      if(run->observe!=NULL)
+        run->observe(run->arg,run->level,run->lvl,&run->state,run->status,tick);
+      if(run->status!=ST_OK)
+      {
+        // Resting height after the roll, then the drop out of sight
+        double y=run->state.orient==STANDING ? 0.5 : 0.25;
+        run->phase=PH_FALLING;
+        run->phase_end=end_tick(tick,(y+FALL_DEPTH)/(run->status==ST_FALL ? FALL_SPEED : SINK_SPEED));
+      }
+      else if(run->state.bridges!=bridges)
+      {
+        run->phase=PH_BRIDGE;
+        run->phase_end=end_tick(tick,90.0/BRIDGE_SPEED);
+      }
+      else
+        run->phase=PH_FREE;
+      break;
+    }
+    case PH_FALLING:
+      if(run->status!=ST_WIN)
+        run->result->restarts++;
+      else if(run->level==run->count)
+      {
+        run->phase=PH_STOPPED;
+        run->result->outcome=RUN_COMPLETED;
+        run->result->end_tick=tick;
+        return;
+      }
+      else
+        run->level++;
+      level_init(run,tick);
+      break;
+  }
+}
+
+/* play_input() at tick: start the oldest queued roll if the block is free */
+static void play_input(Run *run,uint64_t tick)
+{
+  InputEvent e;
+  if(run->phase==PH_FREE&&iq_pop(&run->queue,&e,tick))
+  {
+    run->move=(const char *)memchr(move_key,e.key,4)-move_key;
+    run->phase=PH_ROLLING;
+    run->phase_end=end_tick(tick,ROLL_SECONDS);
+    run->result->rolls++;
+  }
+}
+
+/* Every timeline update up to and including tick */
+static void run_until(Run *run,uint64_t tick)
+{
+  // Rolls that came in together are looked at by the update after them
+  if(run->pushed&&run->pushed_at<tick)
+  {
+    run->pushed=false;
+    play_input(run,run->pushed_at+1);
+  }
+  while(run->phase!=PH_FREE&&run->phase!=PH_STOPPED&&run->phase_end<=tick)
+  {
+    uint64_t k=run->phase_end;
+    phase_done(run,k);
+    play_input(run,k);
+  }
+}
+
+void replay_run(const Replay *replay,const Level *const *levels,int count,
+                ReplayObserver observe,void *arg,ReplayResult *result)
+{
+  Run run;
+  memset(result,0,sizeof(*result));
+  run.observe=observe;
+  run.arg=arg;
+  run.levels=levels;
+  run.count=count;
+  run.level=replay->header.first_level;
+  run.result=result;
+  run.pushed=false;
+  iq_init(&run.queue,replay->header.queue_depth);
+  result->outcome=RUN_ENDED;
+  level_init(&run,0);
+  if(run.phase!=PH_STOPPED&&level_hash(run.lvl)!=replay->header.level_hash)
+  {
+    run.phase=PH_STOPPED;
+    result->outcome=RUN_BAD_LEVEL;
+  }
+  for(size_t i=0;i<replay->event.size()&&run.phase!=PH_STOPPED;i++)
+  {
+    const ReplayEvent *e=&replay->event[i];
+    run_until(&run,e->tick);
+    if(run.phase==PH_STOPPED)
+      break;
+    result->end_tick=e->tick;
+    if(e->type==REPLAY_ROLL)
+    {
+      if(!iq_push(&run.queue,move_key[e->move],e->tick))
+        result->dropped++;
+      run.pushed=true;
+      run.pushed_at=e->tick;
+    }
+    else if(e->type==REPLAY_END||(e->type==REPLAY_CHAR&&(e->code=='q'||e->code=='Q'))||
+            (e->type==REPLAY_KEY&&e->code==KEY_ESCAPE&&e->action==KEY_PRESS))
+    {
+      result->outcome=e->type==REPLAY_END ? RUN_ENDED : RUN_QUIT;
+      break;
+    }
+  }
+  result->level=run.level;
+  result->state=run.state;
+}
+
+void replay_run_files(const char *const *paths,int n,const Level *const *levels,int count,
+                      int threads,ReplayObserver observe,void *arg,ReplayResult *results)
+{
+  std::atomic<int> next(0);
+  std::vector<std::thread> pool;
+  for(int t=0;t<std::max(1,threads);t++)
+    pool.push_back(std::thread([&]() {
+      Replay replay;
+      for(int i=next++;i<n;i=next++)
+      {
+        if(!replay_load(paths[i],&replay))
+        {
+          memset(&results[i],0,sizeof(results[i]));
+          results[i].outcome=RUN_UNREADABLE;
+          continue;
+        }
+        std::chrono::steady_clock::time_point t0=std::chrono::steady_clock::now();
+        replay_run(&replay,levels,count,observe,arg,&results[i]);
+        results[i].seconds=std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+      }
+    }));
+  for(size_t t=0;t<pool.size();t++)
+    pool[t].join();
+}
@@ -0,0 +1,46 @@
+#ifndef REPLAY_RUN_H
+#define REPLAY_RUN_H
+
+#include <stdint.h>
+
+#include "sim.h"
+#include "replay.h"
+
+/*
+ * Headless playback of a replay on the simulation core. Rolls go through
+ * the same input queue as in the game and the game's animations are worked
+ * out as the ticks they end on, so nothing is stepped tick by tick and the
+ * result is what the game would reach.
+ */
+
+enum RunOutcome {
+  RUN_ENDED,          // the log ran out with the game still going
+  RUN_QUIT,           // escape or q
+  RUN_COMPLETED,      // the last level was won
+  RUN_BAD_LEVEL,      // the log starts on a level that is missing or differs
+  RUN_UNREADABLE      // not a replay file
+};
+
+struct ReplayResult {
+  int outcome;
+  int level;                    // LEVEL at the end
+  SimState state;               // of the block on it
+  uint64_t rolls;               // rolls played
+  uint64_t dropped;             // rolls lost to a full queue
+  uint64_t restarts;            // falls and breaks
+  uint64_t end_tick;
+  double seconds;               // spent playing it, without loading
+};
+
+/* Called when a level starts and after every roll, with its Status */
+typedef void (*ReplayObserver)(void *arg,int level,const Level *lvl,const SimState *s,int status,
+                               uint64_t tick);
+
+/* levels[0..count) are the game's levels 1..count. observe may be NULL */
+void replay_run(const Replay *replay,const Level *const *levels,int count,
+                ReplayObserver observe,void *arg,ReplayResult *result);
+/* Load and play paths[0..n) on that many threads */
+void replay_run_files(const char *const *paths,int n,const Level *const *levels,int count,
+                      int threads,ReplayObserver observe,void *arg,ReplayResult *results);
+
+#endif
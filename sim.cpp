@@ -0,0 +1,260 @@
+#include <string.h>
+
+#include "sim.h"
+
+const char move_key[4]={'U','D','L','R'};
+
+const int roll_dx[3][4]={{0,0,-2,1},{0,0,-1,2},{0,0,-1,1}};
+const int roll_dz[3][4]={{-2,1,0,0},{-1,1,0,0},{-1,2,0,0}};
+const int roll_orient[3][4]={{LYING_Z,LYING_Z,LYING_X,LYING_X},
+                                    {LYING_X,LYING_X,STANDING,STANDING},
+                                    {STANDING,STANDING,LYING_Z,LYING_Z}};
+
+void sim_reset(const Level *lvl,SimState *s)
+{
+  s->x=lvl->start_x;s->z=lvl->start_z;
+  s->orient=STANDING;
+  s->bridges=lvl->bridges_start;
+}
+
+int sim_tile(const Level *lvl,uint32_t bridges,int x,int z)
+{
+  if(x<0||z<0||x>=lvl->width||z>=lvl->depth)
+    return TILE_EMPTY;
+  int t=lvl->tile[x*lvl->depth+z];
+  if(t==TILE_EMPTY&&bridges)
+  {
+    for(int i=0;i<lvl->no_of_bridges;i++)
+    {
+      if(!(bridges>>i&1))
+        continue;
+      const SimBridge *b=&lvl->bridge[i];
+      if((b->x[0]==x&&b->z[0]==z)||(b->x[1]==x&&b->z[1]==z))
+        return TILE_NORMAL;
+    }
+  }
+  return t;
+}
+
+static void press_switch(const Level *lvl,SimState *s,int x,int z)
+{
+  for(int i=0;i<lvl->no_of_switches;i++)
+    if(lvl->sw[i].x==x&&lvl->sw[i].z==z)
+      s->bridges^=1u<<lvl->sw[i].bridge;
+}
+
+/* Check_Block_Pos() for one completed roll */
+int sim_step(const Level *lvl,SimState *s,int move)
+{
+  int o=s->orient;
+  s->x+=roll_dx[o][move];
+  s->z+=roll_dz[o][move];
+  s->orient=o=roll_orient[o][move];
+  if(o==STANDING)
+  {
+    int t=sim_tile(lvl,s->bridges,s->x,s->z);
+    if(t==TILE_EMPTY)
+      return ST_FALL;
+    if(t==TILE_FRAGILE)
+      return ST_BREAK;
+    if(s->x==lvl->goal_x&&s->z==lvl->goal_z)
+      return ST_WIN;
+    if(t==TILE_HEAVY)
+      press_switch(lvl,s,s->x,s->z);
+    return ST_OK;
+  }
+  int x1=s->x+(o==LYING_X),z1=s->z+(o==LYING_Z);
+  int a=sim_tile(lvl,s->bridges,s->x,s->z);
+  int b=sim_tile(lvl,s->bridges,x1,z1);
+  if(a==TILE_EMPTY||b==TILE_EMPTY)
+    return ST_FALL;
+  if(o==LYING_X&&a==TILE_SWITCH)
+    press_switch(lvl,s,s->x,s->z);
+  return ST_OK;
+}
+
+uint64_t sim_state_count(const Level *lvl)
+{
+  return ((uint64_t)1<<lvl->no_of_bridges)*lvl->width*lvl->depth*3;
+}
+
+uint64_t sim_state_index(const Level *lvl,const SimState *s)
+{
+  return (((uint64_t)s->bridges*lvl->width+s->x)*lvl->depth+s->z)*3+s->orient;
+}
+
+void sim_state_from_index(const Level *lvl,uint64_t index,SimState *s)
+{
+  s->orient=index%3;index/=3;
+  s->z=index%lvl->depth;index/=lvl->depth;
+  s->x=index%lvl->width;index/=lvl->width;
+  s->bridges=(uint32_t)index;
+}
+
+static uint32_t fnv(uint32_t h,const void *data,size_t n)
+{
+  const uint8_t *p=(const uint8_t *)data;
+  for(size_t i=0;i<n;i++)
+    h=(h^p[i])*16777619u;
+  return h;
+}
+
+uint32_t level_hash(const Level *lvl)
+{
+  int head[8]={lvl->width,lvl->depth,lvl->start_x,lvl->start_z,lvl->goal_x,lvl->goal_z,
+               lvl->no_of_bridges,lvl->no_of_switches};
+  uint32_t h=fnv(2166136261u,head,sizeof(head));
+  h=fnv(h,lvl->tile,(size_t)lvl->width*lvl->depth);
+  h=fnv(h,lvl->bridge,lvl->no_of_bridges*sizeof(SimBridge));
+  h=fnv(h,lvl->sw,lvl->no_of_switches*sizeof(SimSwitch));
+  return fnv(h,&lvl->bridges_start,sizeof(lvl->bridges_start));
+}
+
+void owned_level_alloc(OwnedLevel *o,int width,int depth)
+{
+  memset(o,0,sizeof(*o));
+  o->tile=new uint8_t[(size_t)width*depth]();
+  o->order=new int16_t[(size_t)width*depth*2];
+  o->lvl.width=width;o->lvl.depth=depth;
+  o->lvl.tile=o->tile;
+  o->lvl.tile_order=o->order;
+  o->lvl.bridge=o->bridge;
+  o->lvl.sw=o->sw;
+}
+
+void owned_level_free(OwnedLevel *o)
+{
+  delete[] o->tile;
+  delete[] o->order;
+  memset(o,0,sizeof(*o));
+}
+
+#define MARK_SEEN   0x80
+#define MARK_BRIDGE 0x40
+
+int level_spawn_order(const Level *lvl,uint8_t *tile,int16_t *order,int *unreached_switch)
+{
+  static const int dx[4]={1,-1,0,0},dz[4]={0,0,1,-1};
+  int w=lvl->width,d=lvl->depth,n=1;
+  for(int i=0;i<lvl->no_of_bridges;i++)
+    for(int k=0;k<2;k++)
+      tile[lvl->bridge[i].x[k]*d+lvl->bridge[i].z[k]]|=MARK_BRIDGE;
+  order[0]=lvl->start_x;order[1]=lvl->start_z;
+  tile[lvl->start_x*d+lvl->start_z]|=MARK_SEEN;
+  for(int q=0;q<n;q++)
+  {
+    int x=order[2*q],z=order[2*q+1];
+    for(int k=0;k<4;k++)
+    {
+      int nx=x+dx[k],nz=z+dz[k];
+      if(nx<0||nz<0||nx>=w||nz>=d)
+        continue;
+      uint8_t *t=&tile[nx*d+nz];
+      if(*t==0||*t&MARK_SEEN)
+        continue;
+      *t|=MARK_SEEN;
+      order[2*n]=nx;order[2*n+1]=nz;n++;
+    }
+  }
+  // Drop the bridge cells and the goal hole from the walk
+  int kept=0;
+  for(int q=0;q<n;q++)
+  {
+    int x=order[2*q],z=order[2*q+1];
+    if(tile[x*d+z]&MARK_BRIDGE||(x==lvl->goal_x&&z==lvl->goal_z))
+      continue;
+    order[2*kept]=x;order[2*kept+1]=z;kept++;
+  }
+  if(unreached_switch!=NULL)
+  {
+    *unreached_switch=-1;
+    for(int i=lvl->no_of_switches-1;i>=0;i--)
+      if(!(tile[lvl->sw[i].x*d+lvl->sw[i].z]&MARK_SEEN))
+        *unreached_switch=i;
+  }
+  for(int x=0;x<w;x++)
+    for(int z=0;z<d;z++)
+    {
+      uint8_t *t=&tile[x*d+z];
+      if(*t!=0&&!(*t&(MARK_SEEN|MARK_BRIDGE))&&!(x==lvl->goal_x&&z==lvl->goal_z))
+      {
+        order[2*kept]=x;order[2*kept+1]=z;kept++;
+      }
+      *t&=~(MARK_SEEN|MARK_BRIDGE);
+    }
+  return kept;
+}
+
+/* The three hand made levels, as they used to be written in level_init() */
+static const int level1_pos[]={3,3,3,4,3,5,4,5,5,5,4,6,5,6,6,6,6,5,6,4,7,5,7,4,7,3,8,3,8,2,9,3,9,2,10,3,10,4,10,5,
+                9,5,11,5,10,6,10,7,10,8,9,7,9,8,9,9,8,9,7,9,7,10,6,10,5,10,5,9,5,8,6,8,7,8};
+static const int level2_pos[]={4,10,5,10,5,11,4,11,3,11,3,10,3,9,4,9,2,10,5,9,6,10,7,10,8,10,9,10,8,9,9,9,8,8,9,8,10,8,10,7,
+  10,6,10,5,10,4,11,4,9,4,9,3,10,3,11,3,9,2,10,2,11,2,8,3,8,4,7,3,7,4,6,4,5,4,4,4,4,5,4,6,3,5,3,6,2,5,2,6,
+  2,4,2,3,3,3,4,3};
+static const int level2_fragile[]={10,4,11,4,9,4,9,3,10,3,11,3,9,2,10,2};
+static const int level3_pos[]={4,4,4,5,3,5,3,4,3,3,4,3,2,4,5,3,5,4,5,5,/*6,4,7,4,*/8,4,9,4,8,5,9,5,9,6,8,6,7,6,7,7,8,7,9,7,9,8,
+  8,8,7,8,7,9,8,9,9,9,/*6,8,5,8,*/4,8,4,9,3,9,2,9,2,8,2,7,3,7,4,7
+};
+
+struct BuiltinLevel {
+  uint8_t tile[14*14];
+  int16_t order[400];
+  SimBridge bridge[2];
+  SimSwitch sw[2];
+};
+static BuiltinLevel builtin[3];
+
+static void builtin_tiles(BuiltinLevel *b,Level *lvl,const int *tile_pos,int n)
+{
+  memset(b->tile,0,sizeof(b->tile));
+  for(int i=0;i<n;i++)
+    b->order[i]=tile_pos[i];
+  for(int i=0;i<n;i+=2)
+    b->tile[tile_pos[i]*14+tile_pos[i+1]]=TILE_NORMAL;
+  lvl->width=lvl->depth=14;
+  lvl->tile=b->tile;
+  lvl->tile_order=b->order;
+  lvl->no_of_tiles=n/2;
+  lvl->no_of_bridges=lvl->no_of_switches=0;
+  lvl->bridge=b->bridge;
+  lvl->sw=b->sw;
+  lvl->bridges_start=0;
+}
+
+int builtin_level(int n,Level *lvl)
+{
+  if(n<1||n>3)
+    return 0;
+  BuiltinLevel *b=&builtin[n-1];
+  switch(n)
+  {
+    case 1:
+      builtin_tiles(b,lvl,level1_pos,74);
+      lvl->start_x=3;lvl->start_z=5;
+      lvl->goal_x=6;lvl->goal_z=9;
+      break;
+    case 2:
+      builtin_tiles(b,lvl,level2_pos,96);
+      for(int i=0;i<16;i+=2)
+        b->tile[level2_fragile[i]*14+level2_fragile[i+1]]=TILE_FRAGILE;
+      lvl->start_x=4;lvl->start_z=10;
+      lvl->goal_x=3;lvl->goal_z=4;
+      break;
+    case 3:
+    {
+      builtin_tiles(b,lvl,level3_pos,68);
+      SimBridge b0={{6,7},{4,4}},b1={{5,6},{8,8}};
+      SimSwitch s0={2,4,0,0},s1={9,7,1,0};
+      b->bridge[0]=b0;b->bridge[1]=b1;
+      b->sw[0]=s0;b->sw[1]=s1;
+      lvl->no_of_bridges=lvl->no_of_switches=2;
+      b->tile[2*14+4]=TILE_SWITCH;
+      b->tile[9*14+7]=TILE_HEAVY;
+      lvl->start_x=4;lvl->start_z=4;
+      lvl->goal_x=3;lvl->goal_z=8;
+      break;
+    }
+  }
+  b->tile[lvl->goal_x*14+lvl->goal_z]=TILE_NORMAL;
+  return 1;
+}
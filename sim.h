@@ -0,0 +1,104 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+
+/*
+ * Simulation core: the rules of Check_Block_Pos()/moveBlock() on discrete
+ * cells, without any GL. Used by the solver, the hint tables and the tools.
+ *
+ * Cells are tile indices: tile (x,z) is drawn at (x/2.0, z/2.0) in the game.
+ * A lying block is stored by its lower cell, (x,x+1) or (z,z+1).
+ */
+
+/* Board.tile_type values */
+enum TileType {
+  TILE_EMPTY=0,
+  TILE_NORMAL=1,
+  TILE_FRAGILE=2,     // yellow, breaks under a standing block
+  TILE_SWITCH=3,      // red, toggles when the block lies on it along x
+  TILE_HEAVY=4        // blue, toggles only under a standing block
+};
+
+enum Orient { STANDING=0, LYING_X=1, LYING_Z=2 };
+
+/* Rolls, in the order of the 2 bit move codes. Letters match Block.key */
+enum Move { MOVE_UP=0, MOVE_DOWN=1, MOVE_LEFT=2, MOVE_RIGHT=3 };
+extern const char move_key[4];
+
+/* Where a roll takes the lower cell, and the orientation after it, by [orient][move] */
+extern const int roll_dx[3][4],roll_dz[3][4],roll_orient[3][4];
+
+/* Result of a roll. Values match Block.fall_status */
+enum Status { ST_OK=0, ST_FALL=1, ST_BREAK=3, ST_WIN=5 };
+
+#define MAX_BRIDGES 16
+#define MAX_SWITCHES 32
+
+struct SimBridge {
+  int16_t x[2],z[2];    // the two cells the bridge covers when closed
+};
+
+struct SimSwitch {
+  int16_t x,z;
+  int16_t bridge;       // index into Level.bridge
+  int16_t pad;
+};
+
+/* Static description of a level. All arrays are borrowed, never freed here */
+struct Level {
+  int width,depth;              // x and z extent in cells
+  const uint8_t *tile;          // tile[x*depth+z], bridge cells are TILE_EMPTY
+  int no_of_tiles;
+  const int16_t *tile_order;    // x,z pairs in spawn order, goal excluded
+  int start_x,start_z;
+  int goal_x,goal_z;
+  int no_of_bridges;
+  const SimBridge *bridge;
+  int no_of_switches;
+  const SimSwitch *sw;
+  uint32_t bridges_start;       // bit i set if bridge i starts closed
+};
+
+struct SimState {
+  int x,z;
+  int orient;
+  uint32_t bridges;             // bit i set while bridge i is closed
+};
+
+void sim_reset(const Level *lvl,SimState *s);
+int sim_tile(const Level *lvl,uint32_t bridges,int x,int z);
+int sim_step(const Level *lvl,SimState *s,int move);
+
+/* Dense state numbering used by the tables: ((bridges*width+x)*depth+z)*3+orient */
+uint64_t sim_state_count(const Level *lvl);
+uint64_t sim_state_index(const Level *lvl,const SimState *s);
+void sim_state_from_index(const Level *lvl,uint64_t index,SimState *s);
+
+uint32_t level_hash(const Level *lvl);
+
+/* Heap backed Level for levels built at run time. Not copyable, pass pointers */
+struct OwnedLevel {
+  Level lvl;
+  uint8_t *tile;
+  int16_t *order;
+  SimBridge bridge[MAX_BRIDGES];
+  SimSwitch sw[MAX_SWITCHES];
+};
+
+void owned_level_alloc(OwnedLevel *o,int width,int depth);
+void owned_level_free(OwnedLevel *o);
+
+/*
+ * Fill order with a breadth first spawn order from the start (closed bridges
+ * are walked through but not listed, the goal hole is left out, islands come
+ * last) and return the number of tiles. tile is lvl->tile made writable, it
+ * is used for marks and restored. unreached_switch, if given, gets the first
+ * switch the flood could not reach, or -1.
+ */
+int level_spawn_order(const Level *lvl,uint8_t *tile,int16_t *order,int *unreached_switch);
+
+/* Levels shipped with the game, numbered from 1. Returns 0 past the last one */
+int builtin_level(int n,Level *lvl);
+
+#endif
@@ -0,0 +1,68 @@
+#include "solver.h"
+
+int solve_level(const Level *lvl,SolverWork *work,SolveResult *result)
+{
+  uint64_t count=sim_state_count(lvl);
+  if(work->stamp.size()<count)
+    work->stamp.assign(count,0);
+  if(++work->epoch==0)
+  {
+    work->stamp.assign(work->stamp.size(),0);
+    work->epoch=1;
+  }
+  uint32_t epoch=work->epoch;
+  work->queue.clear();
+  work->parent.clear();
+
+  // queue entries are (state index<<2 | roll that reached it)
+  SimState s,t;
+  sim_reset(lvl,&s);
+  uint64_t start=sim_state_index(lvl,&s);
+  work->stamp[start]=epoch;
+  work->queue.push_back(start<<2);
+  work->parent.push_back(0);
+  uint64_t safe=0;
+  size_t win_from=0;
+  int win_move=-1;
+  for(size_t q=0;q<work->queue.size();q++)
+  {
+    sim_state_from_index(lvl,work->queue[q]>>2,&s);
+    for(int m=0;m<4;m++)
+    {
+      t=s;
+      int status=sim_step(lvl,&t,m);
+      if(status==ST_WIN&&win_move<0)
+      {
+        win_from=q;
+        win_move=m;
+      }
+      if(status!=ST_OK)
+        continue;
+      safe++;
+      uint64_t j=sim_state_index(lvl,&t);
+      if(work->stamp[j]==epoch)
+        continue;
+      work->stamp[j]=epoch;
+      work->queue.push_back(j<<2|m);
+      work->parent.push_back(q);
+    }
+  }
+
+  result->reachable=work->queue.size();
+  result->branching=(double)safe/result->reachable;
+  result->length=-1;
+  result->moves[0]=0;
+  if(win_move<0)
+    return 0;
+  int n=1;
+  for(size_t q=win_from;q!=0;q=work->parent[q])
+    n++;
+  result->length=n;
+  if(n>=(int)sizeof(result->moves))
+    return 1;
+  result->moves[n]=0;
+  result->moves[n-1]=move_key[win_move];
+  for(size_t q=win_from;q!=0;q=work->parent[q])
+    result->moves[--n-1]=move_key[work->queue[q]&3];
+  return 1;
+}
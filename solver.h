@@ -0,0 +1,32 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "sim.h"
+
+/*
+ * In memory BFS from the start of a level. SolverWork holds the scratch
+ * arrays so a thread can solve many levels without reallocating.
+ */
+
+struct SolverWork {
+  std::vector<uint32_t> stamp;      // stamp[index]==epoch once the state is seen
+  std::vector<uint32_t> parent;     // position in queue of the state we came from
+  std::vector<uint64_t> queue;
+  uint32_t epoch;
+  SolverWork() : epoch(0) {}
+};
+
+struct SolveResult {
+  int length;                       // rolls in an optimal solution, -1 if none
+  uint64_t reachable;               // states reachable from the start
+  double branching;                 // average safe rolls per reachable state
+  char moves[1024];                 // move_key letters of one optimal solution
+};
+
+int solve_level(const Level *lvl,SolverWork *work,SolveResult *result);
+
+#endif
@@ -0,0 +1,96 @@
+/* An arena chains blocks when it runs out, merges them on reset and then
+   stops growing; built with BLOX_ARENA_DEBUG its memory is filled, run by
+   make test */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+#define ALLOCS 200
+#define SIZE 1000               // 1008 bytes once aligned
+
+static int failures;
+
+static void expect(const char *what,int ok)
+{
+  if(!ok)
+  {
+    fprintf(stderr,"FAIL %s\n",what);
+    failures++;
+  }
+}
+
+/* ALLOCS allocations, each filled with its number and checked after all */
+static void fill(Arena *a,uint8_t **p)
+{
+  for(int i=0;i<ALLOCS;i++)
+  {
+    p[i]=arena_array<uint8_t>(a,SIZE);
+    memset(p[i],i,SIZE);
+  }
+  int aligned=1,intact=1;
+  for(int i=0;i<ALLOCS;i++)
+  {
+    aligned&=(uintptr_t)p[i]%16==0;
+    for(int k=0;k<SIZE;k++)
+      intact&=p[i][k]==(uint8_t)i;
+  }
+  expect("allocations 16 byte aligned",aligned);
+  expect("allocations do not overlap",intact);
+}
+
+#ifdef BLOX_ARENA_DEBUG
+static int all(const uint8_t *p,size_t n,uint8_t v)
+{
+  for(size_t i=0;i<n;i++)
+    if(p[i]!=v)
+      return 0;
+  return 1;
+}
+#endif
+
+int main()
+{
+  Arena a;
+  uint8_t *p[ALLOCS];
+  arena_init(&a,"test",4096);
+  fill(&a,p);
+  expect("ran past the first block",a.overflows>0&&a.capacity>4096);
+  expect("live bytes counted",a.live==ALLOCS*1008&&a.high_water==a.live);
+
+  // The reset folds the chain into one block of the whole capacity
+  size_t capacity=a.capacity;
+  uint64_t overflows=a.overflows;
+  arena_reset(&a);
+  expect("reset keeps the capacity",a.capacity==capacity&&a.live==0&&a.resets==1);
+  fill(&a,p);
+  expect("no growth after the reset",a.capacity==capacity&&a.overflows==overflows);
+  int contiguous=1;
+  for(int i=1;i<ALLOCS;i++)
+    contiguous&=p[i]==p[i-1]+1008;
+  expect("one block after the reset",contiguous);
+  arena_reset(&a);
+  fill(&a,p);
+  expect("no growth after the second reset",a.capacity==capacity&&a.overflows==overflows);
+  expect("high water kept over resets",a.high_water==ALLOCS*1008);
+
+#ifdef BLOX_ARENA_DEBUG
+  // New memory reads 0xCD, and memory of a block kept over a reset 0xDD
+  arena_reset(&a);
+  uint8_t *q=arena_array<uint8_t>(&a,SIZE);
+  expect("new memory filled with 0xCD",all(q,SIZE,0xCD));
+  memset(q,0x11,SIZE);
+  arena_reset(&a);
+  expect("reset memory filled with 0xDD",all(q,SIZE,0xDD));
+  expect("the next allocation reuses it",arena_array<uint8_t>(&a,SIZE)==q&&all(q,SIZE,0xCD));
+#endif
+
+  arena_free(&a);
+  expect("free drops the blocks",a.capacity==0);
+
+  if(failures==0)
+    printf("arena: all passed\n");
+  return failures==0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,73 @@
+/* env_step plays random games like sim_step, run by make test */
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "env.h"
+
+using namespace std;
+
+static int failures;
+
+static void fail(int n,uint64_t k,int i,const char *what)
+{
+  if(failures<10)
+    fprintf(stderr,"FAIL level %d step %llu game %d: %s\n",n,(unsigned long long)k,i,what);
+  failures++;
+}
+
+/* Each game against its own SimState, episodes of up to limit steps */
+static void check_level(int n,int games,int limit,uint64_t steps)
+{
+  Level lvl;
+  builtin_level(n,&lvl);
+  EnvBatch b;
+  env_reset(&b,&lvl,games,limit);
+  vector<SimState> s(games);
+  vector<int> rolls(games,0);
+  for(int i=0;i<games;i++)
+    sim_reset(&lvl,&s[i]);
+  vector<uint8_t> action(games),done(games);
+  vector<uint64_t> obs(games);
+  vector<float> reward(games);
+  uint64_t rng=0x9E3779B97F4A7C15ull*n;
+  for(uint64_t k=0;k<steps;k++)
+  {
+    for(int i=0;i<games;i++)
+    {
+      rng^=rng<<13;rng^=rng>>7;rng^=rng<<17;
+      action[i]=rng>>32&3;
+    }
+    env_step(&b,&action[0],&obs[0],&reward[0],&done[0]);
+    for(int i=0;i<games;i++)
+    {
+      int status=sim_step(&lvl,&s[i],action[i]);
+      int end=status!=ST_OK||++rolls[i]>=limit;
+      float r=status==ST_WIN ? 1 : status==ST_OK ? 0 : -1;
+      if(end)
+      {
+        sim_reset(&lvl,&s[i]);
+        rolls[i]=0;
+      }
+      if(b.status[i]!=status)
+        fail(n,k,i,"status");
+      else if(done[i]!=end)
+        fail(n,k,i,"done");
+      else if(reward[i]!=r)
+        fail(n,k,i,"reward");
+      else if(obs[i]!=sim_state_index(&lvl,&s[i]))
+        fail(n,k,i,"observation");
+    }
+  }
+}
+
+int main()
+{
+  Level lvl;
+  for(int n=1;builtin_level(n,&lvl);n++)
+    check_level(n,256,40,2000);
+
+  if(failures==0)
+    printf("env: all passed\n");
+  return failures==0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
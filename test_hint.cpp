@@ -0,0 +1,62 @@
+/* The hint table agrees with the solver and its moves reach the goal, run by make test */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "hint.h"
+#include "solver.h"
+
+static int failures;
+
+static void check_level(int n,SolverWork *work)
+{
+  Level lvl;
+  HintTable table;
+  SolveResult result;
+  builtin_level(n,&lvl);
+  if(!hint_table_build(&lvl,&table))
+  {
+    fprintf(stderr,"FAIL level %d: no hint table\n",n);
+    failures++;
+    return;
+  }
+  solve_level(&lvl,work,&result);
+
+  SimState s;
+  sim_reset(&lvl,&s);
+  int distance=hint_distance(&table,sim_state_index(&lvl,&s));
+  if(result.length<0||distance!=result.length)
+  {
+    fprintf(stderr,"FAIL level %d: hint distance %d, solver %d rolls\n",n,distance,result.length);
+    failures++;
+  }
+
+  // Follow the hints from the start, only the last roll may end the game
+  int status=ST_OK,rolls=0;
+  while(status==ST_OK&&rolls<=result.length)
+  {
+    uint64_t index=sim_state_index(&lvl,&s);
+    if(hint_distance(&table,index)==HINT_NONE)
+      break;
+    status=sim_step(&lvl,&s,hint_move(&table,index));
+    rolls++;
+  }
+  if(status!=ST_WIN||rolls!=result.length)
+  {
+    fprintf(stderr,"FAIL level %d: hints end with status %d after %d rolls, solver %d\n",
+            n,status,rolls,result.length);
+    failures++;
+  }
+  hint_table_free(&table);
+}
+
+int main()
+{
+  SolverWork work;
+  Level lvl;
+  for(int n=1;builtin_level(n,&lvl);n++)
+    check_level(n,&work);
+
+  if(failures==0)
+    printf("hint: all passed\n");
+  return failures==0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
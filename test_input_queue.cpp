@@ -0,0 +1,61 @@
+/* Rolls come out of the input queue in order, a full queue drops new ones
+   and the waits are counted, run by make test */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "input_queue.h"
+
+static int failures;
+
+static void expect(const char *what,int ok)
+{
+  if(!ok)
+  {
+    fprintf(stderr,"FAIL %s\n",what);
+    failures++;
+  }
+}
+
+static InputQueue q;
+
+int main()
+{
+  InputEvent e;
+  iq_init(&q,4);
+  expect("empty queue pops nothing",!iq_pop(&q,&e,0));
+
+  // Four fit, the fifth and sixth are dropped and the first four kept
+  const char *keys="UDLRXY";
+  int pushed=0;
+  for(int i=0;i<6;i++)
+    pushed+=iq_push(&q,keys[i],i);
+  expect("a full queue turns down new rolls",pushed==4&&q.count==4&&q.dropped==2);
+  int in_order=1;
+  for(int i=0;i<4;i++)
+    in_order&=iq_pop(&q,&e,10)&&e.key==keys[i]&&e.time==i;
+  expect("rolls pop oldest first",in_order&&!iq_pop(&q,&e,10));
+  expect("waits counted",q.popped==4&&q.wait==10+9+8+7&&q.max_wait==10);
+
+  // Around the end of the ring many times, one behind
+  iq_push(&q,'U',0);
+  in_order=1;
+  for(int i=0;i<10;i++)
+  {
+    in_order&=iq_push(&q,keys[(i+1)%4],i+1);
+    in_order&=iq_pop(&q,&e,i+1)&&e.key==keys[i%4];
+  }
+  expect("order kept around the ring",in_order&&q.count==1);
+
+  iq_clear(&q);
+  expect("clear empties the queue",q.count==0&&!iq_pop(&q,&e,0));
+  expect("clear keeps the counts",q.dropped==2);
+
+  iq_init(&q,0);
+  expect("depth at least 1",q.depth==1&&iq_push(&q,'U',0)&&!iq_push(&q,'D',0));
+  iq_init(&q,INPUT_QUEUE_MAX+1);
+  expect("depth at most INPUT_QUEUE_MAX",q.depth==INPUT_QUEUE_MAX);
+
+  if(failures==0)
+    printf("input_queue: all passed\n");
+  return failures==0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
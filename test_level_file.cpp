@@ -0,0 +1,128 @@
+/* level_file_view takes an intact .blv and turns down corrupted ones, and
+   level_fits_board the levels the game cannot play, run by make test */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "level_file.h"
+
+using namespace std;
+
+static int failures;
+
+/* Built-in level 3, which has bridges and switches, encoded in an 8 byte aligned buffer */
+static void encode(vector<uint64_t> *buf)
+{
+  Level lvl;
+  builtin_level(3,&lvl);
+  size_t size=level_file_size(&lvl);
+  buf->assign((size+7)/8,0);
+  level_file_encode(&lvl,&(*buf)[0]);
+}
+
+static LevelFileHeader *header(vector<uint64_t> *buf)
+{
+  return (LevelFileHeader *)&(*buf)[0];
+}
+
+static void expect(const char *what,vector<uint64_t> *buf,int valid)
+{
+  Level lvl;
+  if(level_file_view(&(*buf)[0],header(buf)->file_size,&lvl)!=valid)
+  {
+    fprintf(stderr,"FAIL %s: %s\n",what,valid ? "rejected" : "accepted");
+    failures++;
+  }
+}
+
+static void expect_fits(const char *what,vector<uint64_t> *buf,int fits)
+{
+  Level lvl;
+  if(!level_file_view(&(*buf)[0],header(buf)->file_size,&lvl))
+  {
+    fprintf(stderr,"FAIL %s: rejected by level_file_view\n",what);
+    failures++;
+  }
+  else if(level_fits_board(&lvl)!=fits)
+  {
+    fprintf(stderr,"FAIL %s: %s the board\n",what,fits ? "does not fit" : "fits");
+    failures++;
+  }
+}
+
+int main()
+{
+  vector<uint64_t> buf;
+  encode(&buf);
+  expect("intact level",&buf,1);
+
+  encode(&buf);
+  SimBridge *b=(SimBridge *)((char *)&buf[0]+header(&buf)->bridge_offset);
+  b->x[0]=5000;b->z[0]=-7;
+  expect("bridge off the board",&buf,0);
+
+  encode(&buf);
+  b=(SimBridge *)((char *)&buf[0]+header(&buf)->bridge_offset);
+  b->x[1]=header(&buf)->start_x;b->z[1]=header(&buf)->start_z;
+  expect("bridge on a tile",&buf,0);
+
+  encode(&buf);
+  uint8_t *tile=(uint8_t *)&buf[0]+header(&buf)->tile_offset;
+  tile[header(&buf)->start_x*header(&buf)->depth+header(&buf)->start_z]=TILE_HEAVY+1;
+  expect("tile byte above TILE_HEAVY",&buf,0);
+
+  encode(&buf);
+  int16_t *order=(int16_t *)((char *)&buf[0]+header(&buf)->order_offset);
+  order[1]=header(&buf)->depth;
+  expect("spawn order off the board",&buf,0);
+
+  encode(&buf);
+  order=(int16_t *)((char *)&buf[0]+header(&buf)->order_offset);
+  order[0]=-1;
+  expect("spawn order below the board",&buf,0);
+
+  encode(&buf);
+  header(&buf)->goal_x=header(&buf)->start_x;
+  header(&buf)->goal_z=header(&buf)->start_z;
+  expect("goal on the start",&buf,0);
+
+  encode(&buf);
+  SimSwitch *sw=(SimSwitch *)((char *)&buf[0]+header(&buf)->switch_offset);
+  sw->bridge=header(&buf)->no_of_bridges;
+  expect("switch of a missing bridge",&buf,0);
+
+  encode(&buf);
+  Level lvl;
+  if(level_file_view(&buf[0],header(&buf)->file_size-1,&lvl))
+  {
+    fprintf(stderr,"FAIL truncated file: accepted\n");
+    failures++;
+  }
+  if(level_file_view((char *)&buf[0]+2,header(&buf)->file_size,&lvl))
+  {
+    fprintf(stderr,"FAIL misaligned data: accepted\n");
+    failures++;
+  }
+
+  encode(&buf);
+  expect_fits("intact level",&buf,1);
+
+  encode(&buf);
+  sw=(SimSwitch *)((char *)&buf[0]+header(&buf)->switch_offset);
+  sw->bridge=1-sw->bridge;
+  expect_fits("switch turning the other bridge",&buf,0);
+
+  encode(&buf);
+  header(&buf)->no_of_switches--;
+  expect_fits("switch tile without its switch",&buf,0);
+
+  encode(&buf);
+  header(&buf)->no_of_switches=0;
+  header(&buf)->no_of_bridges=0;
+  expect_fits("switch tiles without bridges",&buf,0);
+
+  if(failures==0)
+    printf("level_file: all passed\n");
+  return failures==0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
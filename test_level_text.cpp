@@ -0,0 +1,96 @@
+/* level_parse_text takes good levels and turns down bad ones with the right message, run by make test */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "level_text.h"
+
+static int failures;
+
+#define HEADER "size 6 3\nbridge 3 0 3 1\nswitch 1 1 0\ngrid\n"
+
+struct TextCase {
+  const char *what;
+  const char *text;
+  const char *error;            // part of the message, NULL when it parses
+};
+
+static const TextCase cases[]={
+  {"good level",
+   HEADER "#S#.#G\n#r#.##\n######\n",NULL},
+  {"good level with CRLF and comments",
+   "# a comment\r\n\r\nsize 6 3\r\nbridge 3 0 3 1\r\nswitch 1 1 0\r\ngrid\r\n#S#.#G\r\n#r#.##\r\n######\r\n",NULL},
+  {"bridge on a tile",
+   "size 6 3\nbridge 3 2 3 1\nswitch 1 1 0\ngrid\n#S#.#G\n#r#.##\n######\n",
+   "bridge cells must be empty cells on the board"},
+  {"bridge off the board",
+   "size 6 3\nbridge 3 0 9 1\nswitch 1 1 0\ngrid\n#S#.#G\n#r#.##\n######\n",
+   "bridge cells must be empty cells on the board"},
+  {"switch not on r or b",
+   "size 6 3\nbridge 3 0 3 1\nswitch 0 1 0\ngrid\n#S#.#G\n#r#.##\n######\n",
+   "switch not on an r or b tile"},
+  {"switch off the board",
+   "size 6 3\nbridge 3 0 3 1\nswitch 1 7 0\ngrid\n#S#.#G\n#r#.##\n######\n",
+   "switch off the board"},
+  {"switch of a missing bridge",
+   "size 6 3\nbridge 3 0 3 1\nswitch 1 1 1\ngrid\n#S#.#G\n#r#.##\n######\n",
+   "switch refers to a missing bridge"},
+  {"unreachable switch",
+   "size 6 3\nbridge 3 0 3 1\nswitch 0 2 0\ngrid\n#S#.#G\n..#.##\nr.####\n",
+   "switch at 0 2 cannot be reached"},
+  {"short row",
+   HEADER "#S#.#G\n#r#.#\n######\n","line 6: row length differs from the width"},
+  {"long row",
+   HEADER "#S#.#G\n#r#.##\n#######\n","line 7: row length differs from the width"},
+  {"fewer rows",
+   HEADER "#S#.#G\n#r#.##\n","fewer rows than the size says"},
+  {"more rows",
+   HEADER "#S#.#G\n#r#.##\n######\n######\n","line 8: more rows than the size says"},
+  {"no start",
+   HEADER "###.#G\n#r#.##\n######\n","the grid needs exactly one S and one G"},
+  {"no goal",
+   HEADER "#S#.##\n#r#.##\n######\n","the grid needs exactly one S and one G"},
+  {"two starts",
+   HEADER "#S#.#G\n#r#.#S\n######\n","the grid needs exactly one S and one G"},
+  {"unknown tile",
+   HEADER "#S#.#G\n#r#.x#\n######\n","line 6: unknown tile character"},
+  {"no grid",
+   "size 6 3\n","no grid"},
+  {"grid before size",
+   "grid\n#S#.#G\n","line 1: grid before size"},
+  {"unknown line",
+   "sise 6 3\n","line 1: unknown line"},
+  {"empty board",
+   "size 0 3\n","line 1: board too large"},
+  {"bridge without its cells",
+   "size 6 3\nbridge 3 0 3\n","line 2: expected bridge X0 Z0 X1 Z1 [closed]"},
+};
+
+int main()
+{
+  LevelParse p;
+  p.capacity=64;
+  p.tile=new uint8_t[p.capacity];
+  p.order=new int16_t[2*p.capacity];
+  for(size_t i=0;i<sizeof(cases)/sizeof(cases[0]);i++)
+  {
+    const TextCase *c=&cases[i];
+    Level lvl;
+    int ok=level_parse_text(c->text,strlen(c->text),&p,&lvl);
+    if(c->error==NULL&&!ok)
+      fprintf(stderr,"FAIL %s: %s\n",c->what,p.error);
+    else if(c->error!=NULL&&ok)
+      fprintf(stderr,"FAIL %s: accepted\n",c->what);
+    else if(c->error!=NULL&&strstr(p.error,c->error)==NULL)
+      fprintf(stderr,"FAIL %s: \"%s\", expected \"%s\"\n",c->what,p.error,c->error);
+    else
+      continue;
+    failures++;
+  }
+  delete[] p.tile;
+  delete[] p.order;
+
+  if(failures==0)
+    printf("level_text: all passed\n");
+  return failures==0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,122 @@
+/* Frames published to an observation ring read back whole, and lapped ones
+   are reported, run by make test */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "obs_ring.h"
+
+#define SLOTS 64
+#define CELLS 24
+
+static int failures;
+
+static void fail(uint64_t n,const char *what)
+{
+  if(failures<10)
+    fprintf(stderr,"FAIL frame %llu: %s\n",(unsigned long long)n,what);
+  failures++;
+}
+
+/* Frame n's board is (n%5+1) x 4, every 7th one too big for the ring */
+static void write_frame(ObsRing *w,uint64_t n)
+{
+  uint8_t *tile;
+  ObsFrame *f=obs_ring_begin(w,&tile);
+  memset(f,0,sizeof(*f));
+  f->tick=n*3;
+  f->level=n%3+1;
+  f->width=n%7==6 ? 5 : n%5+1;
+  f->depth=n%7==6 ? 5 : 4;
+  f->x=n%11;
+  f->z=n%13;
+  f->orient=n%3;
+  f->bridges=n&3;
+  for(int i=0;i<f->width*f->depth&&i<CELLS;i++)
+    tile[i]=(n+i)%5;
+  obs_ring_publish(w);
+}
+
+static void check_frame(const ObsRing *r,uint64_t n)
+{
+  ObsFrame f;
+  uint8_t tile[CELLS];
+  int got=obs_ring_read(r,n,&f,tile);
+  if(got!=1)
+  {
+    fail(n,got==0 ? "not out" : "overwritten");
+    return;
+  }
+  int big=n%7==6;
+  if(f.tick!=n*3||f.level!=(int)(n%3+1)||f.x!=(int)(n%11)||f.z!=(int)(n%13)||
+     f.orient!=(int)(n%3)||f.bridges!=(n&3))
+    fail(n,"frame differs");
+  else if(big ? f.width!=0||f.depth!=0 : f.width!=(int)(n%5+1)||f.depth!=4)
+    fail(n,big ? "board too big for the ring kept" : "board size differs");
+  else if(f.check!=obs_frame_check(&f,tile))
+    fail(n,"check differs");
+  else
+    for(int i=0;i<f.width*f.depth;i++)
+      if(tile[i]!=(n+i)%5)
+      {
+        fail(n,"tiles differ");
+        break;
+      }
+}
+
+int main()
+{
+  char name[64];
+  snprintf(name,sizeof(name),"/blox_test_%d",(int)getpid());
+  ObsRing w,r;
+  if(!obs_ring_create(&w,name,SLOTS,CELLS)||!obs_ring_open(&r,name))
+  {
+    fprintf(stderr,"FAIL cannot create or open %s\n",name);
+    return EXIT_FAILURE;
+  }
+
+  // Each frame as it comes out, the next one not yet
+  uint64_t n=0;
+  for(;n<10;n++)
+  {
+    write_frame(&w,n);
+    check_frame(&r,n);
+    ObsFrame f;
+    uint8_t tile[CELLS];
+    if(obs_ring_read(&r,n+1,&f,tile)!=0)
+      fail(n+1,"out before it was published");
+  }
+
+  // Three times around: the last SLOTS frames read back, older ones are lapped
+  for(;n<3*SLOTS+5;n++)
+    write_frame(&w,n);
+  if(obs_ring_head(&r)!=n)
+    fail(n,"head differs");
+  for(uint64_t k=0;k<n;k++)
+  {
+    ObsFrame f;
+    uint8_t tile[CELLS];
+    if(k<n-SLOTS)
+    {
+      if(obs_ring_read(&r,k,&f,tile)!=-1)
+        fail(k,"lapped but not reported");
+    }
+    else
+      check_frame(&r,k);
+  }
+
+  obs_ring_close(&r);
+  obs_ring_close(&w);
+  ObsRing gone;
+  if(obs_ring_open(&gone,name))
+  {
+    fprintf(stderr,"FAIL %s still there after the writer closed it\n",name);
+    failures++;
+    obs_ring_close(&gone);
+  }
+
+  if(failures==0)
+    printf("obs_ring: all passed\n");
+  return failures==0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,131 @@
+/* A session written with replay_write loads back the same, run by make test */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#include "replay.h"
+
+using namespace std;
+
+static int failures;
+
+static void fail(const char *what,size_t i)
+{
+  fprintf(stderr,"FAIL event %zu: %s\n",i,what);
+  failures++;
+}
+
+static ReplayEvent event(uint64_t tick,int type)
+{
+  ReplayEvent e;
+  memset(&e,0,sizeof(e));
+  e.tick=tick;
+  e.type=type;
+  return e;
+}
+
+/* Every kind of event, with ticks repeating, one apart and far apart */
+static void session(vector<ReplayEvent> *events)
+{
+  uint64_t tick=0;
+  for(int i=0;i<200;i++)
+  {
+    tick+=i%3==0 ? 0 : i%3==1 ? 1 : (uint64_t)i*i*97;
+    ReplayEvent e=event(tick,REPLAY_ROLL);
+    e.move=i&3;
+    switch(i%7)
+    {
+      case 3:
+        e=event(tick,REPLAY_KEY);
+        e.code=i%2 ? 348 : 65;
+        e.action=i%3;
+        break;
+      case 4:
+        e=event(tick,REPLAY_MOUSE);
+        e.button=i%3;
+        e.action=i%2;
+        e.x=i*1.25f;
+        e.y=-i*0.5f;
+        break;
+      case 5:
+        e=event(tick,REPLAY_CHAR);
+        e.code=i%2 ? 'h' : 0x1F600;
+        break;
+    }
+    events->push_back(e);
+  }
+  events->push_back(event(tick+REPLAY_TICK_HZ,REPLAY_END));
+}
+
+int main()
+{
+  char path[]="/tmp/test_replay_XXXXXX";
+  int fd=mkstemp(path);
+  if(fd<0)
+  {
+    perror("mkstemp");
+    return EXIT_FAILURE;
+  }
+  close(fd);
+
+  vector<ReplayEvent> events;
+  session(&events);
+  ReplayWriter w;
+  int ok=replay_create(&w,path,3,0xdeadbeef,8);
+  for(size_t i=0;i+1<events.size()&&ok;i++)
+    ok=replay_write(&w,&events[i]);
+  ok=replay_finish(&w,events.back().tick)&&ok;
+  if(!ok||w.events!=events.size())
+  {
+    fprintf(stderr,"FAIL writing %s\n",path);
+    failures++;
+  }
+
+  Replay replay;
+  if(!replay_load(path,&replay))
+  {
+    fprintf(stderr,"FAIL loading %s\n",path);
+    unlink(path);
+    return EXIT_FAILURE;
+  }
+  if(replay.header.first_level!=3||replay.header.level_hash!=0xdeadbeef||replay.header.queue_depth!=8)
+  {
+    fprintf(stderr,"FAIL header\n");
+    failures++;
+  }
+  if(replay.event.size()!=events.size())
+  {
+    fprintf(stderr,"FAIL %zu events loaded, %zu written\n",replay.event.size(),events.size());
+    failures++;
+  }
+  for(size_t i=0;i<replay.event.size()&&i<events.size();i++)
+  {
+    const ReplayEvent *a=&events[i],*b=&replay.event[i];
+    if(a->tick!=b->tick)
+      fail("tick",i);
+    else if(a->type!=b->type)
+      fail("type",i);
+    else if(a->type==REPLAY_ROLL&&a->move!=b->move)
+      fail("move",i);
+    else if((a->type==REPLAY_KEY||a->type==REPLAY_CHAR)&&a->code!=b->code)
+      fail("code",i);
+    else if((a->type==REPLAY_KEY||a->type==REPLAY_MOUSE)&&a->action!=b->action)
+      fail("action",i);
+    else if(a->type==REPLAY_MOUSE&&(a->button!=b->button||a->x!=b->x||a->y!=b->y))
+      fail("button or cursor",i);
+  }
+
+  // Cut before the REPLAY_END event, the log is turned down
+  if(truncate(path,w.bytes-2)!=0||replay_load(path,&replay))
+  {
+    fprintf(stderr,"FAIL truncated log: accepted\n");
+    failures++;
+  }
+  unlink(path);
+
+  if(failures==0)
+    printf("replay: all passed\n");
+  return failures==0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,123 @@
+/* Tracks move their targets and call back in order, and a callback that
+   clears the timeline stops the rest, run by make test */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+
+#include "timeline.h"
+
+using namespace std;
+
+static int failures;
+
+static void expect(const char *what,int ok)
+{
+  if(!ok)
+  {
+    fprintf(stderr,"FAIL %s\n",what);
+    failures++;
+  }
+}
+
+static vector<int> called;
+static Timeline tl;
+static double value;
+
+static void record(void *arg)
+{
+  called.push_back((int)(intptr_t)arg);
+}
+
+static void record_and_clear(void *arg)
+{
+  record(arg);
+  tl_clear(&tl);
+}
+
+static void record_and_add(void *arg)
+{
+  record(arg);
+  tl_add(&tl,&value,0,1,10,1,EASE_LINEAR,record,(void *)(intptr_t)100);
+}
+
+static int called_is(const int *order,size_t n)
+{
+  if(called.size()!=n)
+    return 0;
+  for(size_t i=0;i<n;i++)
+    if(called[i]!=order[i])
+      return 0;
+  return 1;
+}
+
+int main()
+{
+  tl_init(&tl);
+
+  // Values along the way for each easing, then exactly the end value
+  double v[4];
+  for(int e=0;e<4;e++)
+    tl_add(&tl,&v[e],2,6,1,2,e,NULL,NULL);
+  expect("targets start at from",v[0]==2&&v[3]==2);
+  tl_update(&tl,0.5);
+  expect("nothing moves before the start",v[0]==2&&v[1]==2&&v[2]==2&&v[3]==2);
+  tl_update(&tl,2);
+  expect("linear half way",fabs(v[EASE_LINEAR]-4)<1e-9);
+  expect("ease in half way",fabs(v[EASE_IN]-3)<1e-9);
+  expect("ease out half way",fabs(v[EASE_OUT]-5)<1e-9);
+  expect("ease in out half way",fabs(v[EASE_IN_OUT]-4)<1e-9);
+  tl_update(&tl,5);
+  expect("every easing ends at to",v[0]==6&&v[1]==6&&v[2]==6&&v[3]==6);
+  expect("ended tracks removed",tl_count(&tl)==0);
+
+  // Tracks ending in the same update call back in the order they were added
+  for(int i=0;i<6;i++)
+    tl_add(&tl,NULL,0,0,0,i%2 ? 1 : 3,EASE_LINEAR,record,(void *)(intptr_t)i);
+  tl_update(&tl,1);
+  static const int odd[3]={1,3,5};
+  expect("the ended ones call back in order",called_is(odd,3)&&tl_count(&tl)==3);
+  called.clear();
+  tl_update(&tl,3);
+  static const int even[3]={0,2,4};
+  expect("then the rest in order",called_is(even,3)&&tl_count(&tl)==0);
+
+  // A zero length timer fires once its start is reached
+  called.clear();
+  tl_add(&tl,NULL,0,0,2,0,EASE_LINEAR,record,(void *)(intptr_t)7);
+  tl_update(&tl,1.5);
+  expect("zero length timer waits for its start",called.empty());
+  tl_update(&tl,2);
+  static const int seven[1]={7};
+  expect("zero length timer fires at its start",called_is(seven,1));
+
+  // A canceled track never calls back
+  called.clear();
+  tl_add(&tl,&value,0,1,0,1,EASE_LINEAR,record,(void *)(intptr_t)8);
+  tl_cancel(&tl,&value);
+  tl_update(&tl,5);
+  expect("canceled track silent",called.empty()&&tl_count(&tl)==0);
+
+  // A callback may add tracks, which run from the next update
+  tl_add(&tl,NULL,0,0,0,1,EASE_LINEAR,record_and_add,(void *)(intptr_t)1);
+  tl_update(&tl,1);
+  static const int added[1]={1};
+  expect("a callback adds a track",called_is(added,1)&&tl_count(&tl)==1);
+  tl_update(&tl,11);
+  static const int added_done[2]={1,100};
+  expect("the added track runs",called_is(added_done,2)&&value==1);
+
+  // Clearing from a callback drops the callbacks still due in that update
+  called.clear();
+  tl_add(&tl,NULL,0,0,0,1,EASE_LINEAR,record,(void *)(intptr_t)1);
+  tl_add(&tl,NULL,0,0,0,1,EASE_LINEAR,record_and_clear,(void *)(intptr_t)2);
+  tl_add(&tl,NULL,0,0,0,1,EASE_LINEAR,record,(void *)(intptr_t)3);
+  tl_add(&tl,NULL,0,0,0,5,EASE_LINEAR,record,(void *)(intptr_t)4);
+  tl_update(&tl,1);
+  static const int cleared[2]={1,2};
+  expect("callbacks after a clear are dropped",called_is(cleared,2)&&tl_count(&tl)==0);
+
+  if(failures==0)
+    printf("timeline: all passed\n");
+  return failures==0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
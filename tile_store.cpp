@@ -0,0 +1,104 @@
+#include <string.h>
+
+#include "tile_store.h"
+
+static inline int32_t *chunk_slot(TileStore *t,int x,int z)
+{
+  return &t->chunk_at[x/TILE_CHUNK*t->chunks_z+z/TILE_CHUNK];
+}
+
+static void put(TileStore *t,int k,int x,int z,int type)
+{
+  TileChunk *c=&t->chunk[*chunk_slot(t,x,z)];
+  float fx=x*0.5f,fz=z*0.5f;
+  t->x[k]=fx;
+  t->z[k]=fz;
+  t->type[k]=type;
+  c->at[x%TILE_CHUNK*TILE_CHUNK+z%TILE_CHUNK]=k;
+  if(fx<c->x0) c->x0=fx;
+  if(fx>c->x1) c->x1=fx;
+  if(fz<c->z0) c->z0=fz;
+  if(fz>c->z1) c->z1=fz;
+}
+
+void tile_store_build(TileStore *t,const Level *lvl,Arena *arena)
+{
+  int d=lvl->depth;
+  size_t cells=(size_t)lvl->width*d;
+  t->width=lvl->width;
+  t->depth=d;
+  t->chunks_x=(lvl->width+TILE_CHUNK-1)/TILE_CHUNK;
+  t->chunks_z=(d+TILE_CHUNK-1)/TILE_CHUNK;
+  size_t chunks=(size_t)t->chunks_x*t->chunks_z;
+  t->chunk_at=arena_array<int32_t>(arena,chunks+1);
+  memset(t->chunk_at,0xff,chunks*sizeof(int32_t));
+
+  // Mark the chunks with anything on them, then number them in order
+  size_t ground=0;
+  for(size_t c=0;c<cells;c++)
+    if(lvl->tile[c]!=TILE_EMPTY)
+    {
+      ground++;
+      *chunk_slot(t,c/d,c%d)=0;
+    }
+  for(int k=0;k<lvl->no_of_tiles;k++)
+    *chunk_slot(t,lvl->tile_order[2*k],lvl->tile_order[2*k+1])=0;
+  for(int i=0;i<lvl->no_of_bridges;i++)
+    for(int h=0;h<2;h++)
+      *chunk_slot(t,lvl->bridge[i].x[h],lvl->bridge[i].z[h])=0;
+  int n=0;
+  for(size_t c=0;c<chunks;c++)
+    if(t->chunk_at[c]==0)
+      t->chunk_at[c]=n++;
+  t->no_of_chunks=n;
+  t->chunk=arena_array<TileChunk>(arena,n+1);
+  for(size_t c=0;c<chunks;c++)
+    if(t->chunk_at[c]>=0)
+    {
+      TileChunk *ch=&t->chunk[t->chunk_at[c]];
+      ch->cx=c/t->chunks_z;
+      ch->cz=c%t->chunks_z;
+      ch->first=ch->count=0;
+      ch->x0=ch->z0=1e30f;
+      ch->x1=ch->z1=-1e30f;
+      ch->dirty=false;
+      memset(ch->at,0xff,sizeof(ch->at));
+    }
+
+  // Each chunk's tiles start where the ones before it end
+  for(int k=0;k<lvl->no_of_tiles;k++)
+    t->chunk[*chunk_slot(t,lvl->tile_order[2*k],lvl->tile_order[2*k+1])].count++;
+  for(int i=0,first=0;i<n;i++)
+  {
+    t->chunk[i].first=first;
+    first+=t->chunk[i].count;
+    t->chunk[i].count=0;
+  }
+
+  t->no_of_tiles=lvl->no_of_tiles;
+  t->count=lvl->no_of_tiles+2*lvl->no_of_bridges;
+  n=t->count+(ground>(size_t)lvl->no_of_tiles ? ground-lvl->no_of_tiles : 0);
+  t->x=arena_array<float>(arena,n);
+  t->z=arena_array<float>(arena,n);
+  t->type=arena_array<uint8_t>(arena,n);
+  t->spawn=arena_array<int32_t>(arena,lvl->no_of_tiles+1);
+  for(int k=0;k<lvl->no_of_tiles;k++)
+  {
+    int x=lvl->tile_order[2*k],z=lvl->tile_order[2*k+1];
+    TileChunk *c=&t->chunk[*chunk_slot(t,x,z)];
+    int e=c->first+c->count++;
+    t->spawn[e]=k;
+    put(t,e,x,z,lvl->tile[x*d+z]);
+  }
+  for(int i=0;i<lvl->no_of_bridges;i++)
+    for(int h=0;h<2;h++)
+    {
+      const SimBridge *b=&lvl->bridge[i];
+      put(t,lvl->no_of_tiles+2*i+h,b->x[h],b->z[h],lvl->bridges_start>>i&1 ? TILE_NORMAL : TILE_EMPTY);
+    }
+  int k=t->count;
+  for(size_t c=0;c<cells&&k<n;c++)
+    if(lvl->tile[c]!=TILE_EMPTY&&tile_entry(t,c/d,c%d)<0)
+      put(t,k++,c/d,c%d,lvl->tile[c]);
+  t->entries=k;
+}
@@ -0,0 +1,69 @@
+#ifndef TILE_STORE_H
+#define TILE_STORE_H
+
+#include <stdint.h>
+
+#include "arena.h"
+#include "sim.h"
+
+/*
+ * The tiles of a level as parallel arrays in instance order: the tiles,
+ * then the two halves of each bridge, then the floor that is not drawn (the
+ * goal). Places are floats and types bytes, so a pass over a million tiles
+ * streams through a few contiguous arrays instead of hopping between per
+ * cell grids.
+ *
+ * The board is cut into chunks of TILE_CHUNK x TILE_CHUNK cells and only
+ * chunks with floor on them exist, so memory goes with the tiles and not
+ * with the area of the board. Tiles are ordered chunk by chunk, each chunk
+ * in spawn order, which makes a chunk's tiles one run of instances: the
+ * chunk's mesh on the GPU, drawn or culled as a whole. A level small enough
+ * for one chunk keeps its spawn order.
+ */
+
+#define TILE_CHUNK 32
+
+struct TileChunk {
+  int cx,cz;                    // its first cell is (cx*TILE_CHUNK,cz*TILE_CHUNK)
+  int first,count;              // its tiles' instances
+  float x0,z0,x1,z1;            // the centres of its tiles, bridge halves and floor span these
+  bool dirty;                   // the game changed the type of one of its entries
+  int32_t at[TILE_CHUNK*TILE_CHUNK]; // entry on each cell, x major, -1 for none
+};
+
+struct TileStore {
+  int width,depth;
+  int chunks_x,chunks_z;
+  int32_t *chunk_at;            // chunk_at[cx*chunks_z+cz] indexes chunk, -1 for none
+  TileChunk *chunk;             // in instance order
+  int no_of_chunks;
+  int no_of_tiles;
+  int count;                    // instances: no_of_tiles plus two per bridge
+  int entries;                  // count plus the cells with no instance
+  float *x,*z;                  // centre of the cell in world units, cell/2
+  uint8_t *type;                // TileType; a bridge half is TILE_NORMAL while closed
+  int32_t *spawn;               // place of each tile in the level's spawn order
+};
+
+/* Everything is allocated from arena and lives as long as it. lvl must be
+   a checked one, from level_file_view, the text parser or builtin_level:
+   its tiles, spawn order and bridges are all on the board, unchecked here */
+void tile_store_build(TileStore *t,const Level *lvl,Arena *arena);
+
+/* The chunk a cell is in, NULL for none or off the board */
+static inline TileChunk *tile_chunk(const TileStore *t,int x,int z)
+{
+  if(x<0||z<0||x>=t->width||z>=t->depth)
+    return NULL;
+  int c=t->chunk_at[x/TILE_CHUNK*t->chunks_z+z/TILE_CHUNK];
+  return c<0 ? NULL : &t->chunk[c];
+}
+
+/* The entry on a cell, -1 for none or off the board */
+static inline int tile_entry(const TileStore *t,int x,int z)
+{
+  const TileChunk *c=tile_chunk(t,x,z);
+  return c==NULL ? -1 : c->at[x%TILE_CHUNK*TILE_CHUNK+z%TILE_CHUNK];
+}
+
+#endif
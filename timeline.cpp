@@ -0,0 +1,128 @@
+#include <chrono>
+
+#include "timeline.h"
+
+/* Room for more tracks than the game ever runs at once, so a frame never allocates */
+#define TL_RESERVE 64
+
+void tl_init(Timeline *tl)
+{
+  tl_clear(tl);
+  tl->start.reserve(TL_RESERVE);tl->rate.reserve(TL_RESERVE);
+  tl->from.reserve(TL_RESERVE);tl->delta.reserve(TL_RESERVE);
+  tl->target.reserve(TL_RESERVE);tl->ease.reserve(TL_RESERVE);
+  tl->done.reserve(TL_RESERVE);tl->arg.reserve(TL_RESERVE);
+  tl->t.reserve(TL_RESERVE);
+  tl->pending_done.reserve(TL_RESERVE);tl->pending_arg.reserve(TL_RESERVE);
+  tl->generation=0;
+  tl->updates=tl->evaluated=0;
+  tl->seconds=0;
+}
+
+int tl_add(Timeline *tl,double *target,double from,double to,double start,double duration,
+           int ease,TimelineDone done,void *arg)
+{
+  tl->start.push_back(start);
+  tl->rate.push_back(duration>0 ? 1/duration : 0);
+  tl->from.push_back(from);
+  tl->delta.push_back(to-from);
+  tl->target.push_back(target);
+  tl->ease.push_back(ease);
+  tl->done.push_back(done);
+  tl->arg.push_back(arg);
+  if(target!=NULL)
+    *target=from;
+  return tl->start.size()-1;
+}
+
+static void move_track(Timeline *tl,int to,int from)
+{
+  tl->start[to]=tl->start[from];
+  tl->rate[to]=tl->rate[from];
+  tl->from[to]=tl->from[from];
+  tl->delta[to]=tl->delta[from];
+  tl->target[to]=tl->target[from];
+  tl->ease[to]=tl->ease[from];
+  tl->done[to]=tl->done[from];
+  tl->arg[to]=tl->arg[from];
+}
+
+static void keep_tracks(Timeline *tl,int n)
+{
+  tl->start.resize(n);tl->rate.resize(n);
+  tl->from.resize(n);tl->delta.resize(n);
+  tl->target.resize(n);tl->ease.resize(n);
+  tl->done.resize(n);tl->arg.resize(n);
+}
+
+void tl_cancel(Timeline *tl,const double *target)
+{
+  int n=tl->start.size(),kept=0;
+  for(int i=0;i<n;i++)
+    if(tl->target[i]!=target)
+      move_track(tl,kept++,i);
+  keep_tracks(tl,kept);
+}
+
+void tl_clear(Timeline *tl)
+{
+  tl->start.clear();tl->rate.clear();
+  tl->from.clear();tl->delta.clear();
+  tl->target.clear();tl->ease.clear();
+  tl->done.clear();tl->arg.clear();
+  tl->generation++;
+}
+
+int tl_count(const Timeline *tl)
+{
+  return tl->start.size();
+}
+
+void tl_update(Timeline *tl,double now)
+{
+  std::chrono::steady_clock::time_point t0=std::chrono::steady_clock::now();
+  int n=tl->start.size();
+  tl->t.resize(n);
+  double *t=n>0 ? &tl->t[0] : NULL;
+
+  // Progress of every track, a straight loop the compiler vectorizes
+  for(int i=0;i<n;i++)
+  {
+    double x=tl->rate[i]>0 ? (now-tl->start[i])*tl->rate[i] : now>=tl->start[i];
+    t[i]=x<0 ? 0 : x>1 ? 1 : x;
+  }
+  for(int i=0;i<n;i++)
+  {
+    double x=t[i];
+    switch(tl->ease[i])
+    {
+      case EASE_IN: x=x*x; break;
+      case EASE_OUT: x=x*(2-x); break;
+      case EASE_IN_OUT: x=x<0.5 ? 2*x*x : 1-2*(1-x)*(1-x); break;
+    }
+    if(tl->target[i]!=NULL)
+      *tl->target[i]=tl->from[i]+tl->delta[i]*x;
+  }
+
+  // Ended tracks go first, so callbacks can add or clear tracks freely;
+  // the others keep their order
+  tl->pending_done.clear();
+  tl->pending_arg.clear();
+  int kept=0;
+  for(int i=0;i<n;i++)
+    if(t[i]<1)
+      move_track(tl,kept++,i);
+    else if(tl->done[i]!=NULL)
+    {
+      tl->pending_done.push_back(tl->done[i]);
+      tl->pending_arg.push_back(tl->arg[i]);
+    }
+  keep_tracks(tl,kept);
+  tl->updates++;
+  tl->evaluated+=n;
+  tl->seconds+=std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+
+  unsigned generation=tl->generation;
+  for(size_t k=0;k<tl->pending_done.size()&&tl->generation==generation;k++)
+    tl->pending_done[k](tl->pending_arg[k]);
+}
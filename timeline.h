@@ -0,0 +1,47 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <stdint.h>
+#include <vector>
+
+/*
+ * Time based tweens. A track moves a double from one value to another over
+ * a duration with an easing curve, and may call back when it is done (a
+ * track without a target is just a timer). Tracks live in parallel arrays
+ * and are all evaluated in one pass per frame, so speed does not depend
+ * on the frame rate and thousands of tracks stay cheap.
+ */
+
+enum { EASE_LINEAR, EASE_IN, EASE_OUT, EASE_IN_OUT };
+
+typedef void (*TimelineDone)(void *arg);
+
+struct Timeline {
+  std::vector<double> start,rate;   // rate is 1/duration
+  std::vector<double> from,delta;
+  std::vector<double*> target;
+  std::vector<uint8_t> ease;
+  std::vector<TimelineDone> done;
+  std::vector<void*> arg;
+  std::vector<double> t;            // scratch for the batched pass
+  std::vector<TimelineDone> pending_done;
+  std::vector<void*> pending_arg;
+  unsigned generation;              // bumped by tl_clear
+  // Profile of tl_update
+  uint64_t updates,evaluated;
+  double seconds;
+};
+
+void tl_init(Timeline *tl);
+int tl_add(Timeline *tl,double *target,double from,double to,double start,double duration,
+           int ease,TimelineDone done,void *arg);
+/* Drop the tracks moving target, without calling back */
+void tl_cancel(Timeline *tl,const double *target);
+void tl_clear(Timeline *tl);
+int tl_count(const Timeline *tl);
+/* Write every target for time now, then call back the tracks that ended in
+   the order they were added. A callback that clears the timeline drops the
+   callbacks still due */
+void tl_update(Timeline *tl,double now);
+
+#endif